@@ -0,0 +1,218 @@
+/*
+ * dmlApi.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ */
+
+#include "dmlApi.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../utils/Eigen3.h"
+#include "../emkmeans/EMKMeans.h"
+#include "../constraint/ConstraintsManager.h"
+#include "../mpckmeans/MPCKMeans.h"
+#include "../globalMetric/GlobalMetricKMeans.h"
+
+namespace dml {
+
+namespace {
+
+thread_local std::string lastError;
+
+/**
+ * the pairs of a flat array (idx1, idx2, idx1, idx2...), checked against nData
+ */
+std::vector<std::pair<int, int> > readLinks(const int* links, const int numLinks, const int nData) {
+	if (numLinks < 0 || (numLinks > 0 && nullptr == links)) {
+		throw std::invalid_argument("Missing constraint array");
+	}
+	std::vector<std::pair<int, int> > pairs;
+	pairs.reserve(numLinks);
+	for (int i = 0; i < numLinks; ++i) {
+		int idx1 = links[2 * i], idx2 = links[2 * i + 1];
+		if (std::min(idx1, idx2) < 0 || std::max(idx1, idx2) >= nData) {
+			throw std::invalid_argument("Constraint on a point out of the data set: "
+				+ std::to_string(idx1) + " " + std::to_string(idx2));
+		}
+		pairs.push_back(std::make_pair(idx1, idx2));
+	}
+	return pairs;
+}
+
+/**
+ * the algorithm picked by options->algorithm, as executeAlgo of ml.cpp
+ */
+template <typename Storage, typename Acc>
+std::unique_ptr<EMKMeans<Storage, Acc> > createAlgorithm(const Eigen::Ref<const Eigen::MatrixX<Storage> >& X,
+	const DmlOptions& options, const ConstraintPtr constraints) {
+
+	std::unique_ptr<EMKMeans<Storage, Acc> > emkmeans;
+	switch (options.algorithm) {
+	case DML_PCKMEANS_NOMETRIC:
+		emkmeans.reset(new GlobalMetricKMeans<EuclideanMetric, Storage, Acc>(X, options.numClusters, constraints));
+		break;
+	case DML_MPCKMEANS_GLOBAL_DIAGONAL:
+		emkmeans.reset(new GlobalMetricKMeans<DiagonalMetric, Storage, Acc>(X, options.numClusters, constraints));
+		break;
+	case DML_MPCKMEANS_GLOBAL_FULL:
+		emkmeans.reset(new GlobalMetricKMeans<FullMetric, Storage, Acc>(X, options.numClusters, constraints));
+		break;
+	case DML_MPCKMEANS_LOCAL_DIAGONAL:
+		emkmeans.reset(new MPCKMeans<DiagonalMetric, Storage, Acc>(X, options.numClusters, constraints));
+		break;
+	case DML_MPCKMEANS_LOCAL_FULL:
+		emkmeans.reset(new MPCKMeans<FullMetric, Storage, Acc>(X, options.numClusters, constraints));
+		break;
+	case DML_MPCKMEANS_GLOBAL_LOWRANK:
+		emkmeans.reset(new GlobalMetricKMeans<LowRankMetric, Storage, Acc>(X, options.numClusters, constraints));
+		break;
+	case DML_MPCKMEANS_LOCAL_LOWRANK:
+		emkmeans.reset(new MPCKMeans<LowRankMetric, Storage, Acc>(X, options.numClusters, constraints));
+		break;
+	default:
+		throw std::invalid_argument("Unknown algorithm " + std::to_string(options.algorithm));
+	}
+
+	emkmeans->setNumThreads(options.numThreads);
+	emkmeans->setOnlineUpdate(0 != options.onlineUpdate);
+	emkmeans->setDiameterMethod(options.diameterSweep ? DIAMETER_SWEEP : DIAMETER_EXACT);
+	emkmeans->setConstraintModel(options.constraintComponents ? CONSTRAINT_COMPONENTS : CONSTRAINT_PAIRS);
+	emkmeans->setBoundPruning(0 != options.boundPruning);
+	emkmeans->setCenterIndex(0 != options.centerIndex);
+	emkmeans->setMiniBatchSize(options.miniBatchSize);
+	emkmeans->setMetricRank(options.metricRank);
+	emkmeans->setSeed((0 != options.seed) ? options.seed : std::random_device()());
+	if (nullptr != options.logCallback) {
+		auto callback = options.logCallback;
+		void* userData = options.logUserData;
+		emkmeans->setLogger([callback, userData](const std::string& message) {
+			callback(message.c_str(), userData);
+		});
+	}
+	return emkmeans;
+}
+
+template <typename Storage, typename Acc>
+EMResult runAlgorithm(const Eigen::Ref<const Eigen::MatrixX<Storage> >& X,
+	const DmlOptions& options, const ConstraintPtr constraints, std::vector<int>& vAssign) {
+
+	std::unique_ptr<EMKMeans<Storage, Acc> > emkmeans = createAlgorithm<Storage, Acc>(X, options, constraints);
+	vAssign = emkmeans->doClustering(options.maxIteration, options.minObjFuncChange);
+	return emkmeans->getResult();
+}
+
+} /* namespace */
+
+} /* namespace dml */
+
+using namespace dml;
+
+void dmlDefaultOptions(DmlOptions* options) {
+	if (nullptr == options) return;
+	*options = DmlOptions();
+	options->algorithm = DML_PCKMEANS_NOMETRIC;
+	options->numClusters = 10;
+	options->maxIteration = 20;
+	options->minObjFuncChange = 0.01f;
+	options->precision = DML_PRECISION_FLOAT;
+	options->numThreads = 1;
+	options->metricRank = DEFAULT_METRIC_RANK;
+}
+
+int dmlCluster(const float* data, int nDims, int nData,
+	const int* mustLinks, int numMustLinks,
+	const int* cannotLinks, int numCannotLinks,
+	const DmlOptions* options, int* assignment, DmlResult* result) {
+
+	lastError.clear();
+	std::vector<std::pair<int, int> > mlLinks, clLinks;
+	try {
+		if (nullptr == data || nullptr == options || nullptr == assignment || nDims <= 0 || nData <= 0) {
+			throw std::invalid_argument("Missing data set, options or assignment buffer");
+		}
+		if (options->numClusters <= 0 || options->numClusters > nData) {
+			throw std::invalid_argument("Invalid number of clusters " + std::to_string(options->numClusters));
+		}
+		if (options->maxIteration <= 0) {
+			throw std::invalid_argument("maxIteration must be positive");
+		}
+		if (!(options->minObjFuncChange >= 0.0f)) {
+			throw std::invalid_argument("minObjFuncChange must be non-negative");
+		}
+		if (options->numThreads < 0 || options->miniBatchSize < 0) {
+			throw std::invalid_argument("numThreads and miniBatchSize must be non-negative");
+		}
+		bool lowRank = (DML_MPCKMEANS_GLOBAL_LOWRANK == options->algorithm)
+			|| (DML_MPCKMEANS_LOCAL_LOWRANK == options->algorithm);
+		if (lowRank && options->metricRank <= 0) {
+			throw std::invalid_argument("metricRank must be positive");
+		}
+		mlLinks = readLinks(mustLinks, numMustLinks, nData);
+		clLinks = readLinks(cannotLinks, numCannotLinks, nData);
+	} catch (const std::exception& e) {
+		lastError = e.what();
+		return DML_INVALID_ARGUMENT;
+	}
+
+	try {
+		std::shared_ptr<ConstraintsManager> constraints(new ConstraintsManager(""));
+		constraints->refineConstraints(mlLinks, clLinks);
+		constraints->deriveConnectedComponents();
+		constraints->nConstraintsOriginal = numMustLinks + numCannotLinks;
+		constraints->nConstraintsDeduced = constraints->nConstraintsOriginal;
+
+		// the caller's buffer, read in place
+		Eigen::Map<const Eigen::MatrixXf> X(data, nDims, nData);
+		std::vector<int> vAssign;
+		EMResult emResult;
+		switch (options->precision) {
+		case DML_PRECISION_FLOAT:
+			emResult = runAlgorithm<float, float>(X, *options, constraints, vAssign);
+			break;
+		case DML_PRECISION_DOUBLE:
+			emResult = runAlgorithm<float, double>(X, *options, constraints, vAssign);
+			break;
+		case DML_PRECISION_HALF: {
+			Eigen::MatrixX<Eigen::half> Xh = X.cast<Eigen::half>();
+			emResult = runAlgorithm<Eigen::half, float>(Xh, *options, constraints, vAssign);
+			break;
+		}
+		default:
+			lastError = "Unknown precision " + std::to_string(options->precision);
+			return DML_INVALID_ARGUMENT;
+		}
+
+		std::copy(vAssign.begin(), vAssign.end(), assignment);
+		if (nullptr != result) {
+			result->iterations = (int) emResult.iterTerminate;
+			result->cost = emResult.cost;
+			result->reachLocalMinimal = (int) emResult.reachLocalMinimal;
+			result->numMLViolation = (int) emResult.nMLViolation;
+			result->numCLViolation = (int) emResult.nCLViolation;
+			result->numDistEvaluated = emResult.nDistEvaluated;
+			result->numDistSkipped = emResult.nDistSkipped;
+		}
+	} catch (const std::invalid_argument& e) {
+		lastError = e.what();
+		return DML_INVALID_ARGUMENT;
+	} catch (const std::exception& e) {
+		lastError = e.what();
+		return DML_CLUSTERING_FAILED;
+	} catch (...) {
+		lastError = "The clustering failed";
+		return DML_CLUSTERING_FAILED;
+	}
+	return DML_OK;
+}
+
+const char* dmlLastError(void) {
+	return lastError.c_str();
+}
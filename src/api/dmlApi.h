@@ -0,0 +1,128 @@
+/*
+ * dmlApi.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * C interface of the library, to embed the clustering in another program:
+ * the data set, the constraints and the assignment are buffers owned by the
+ * caller, nothing is read from or written to disk.
+ * The structs only grow at their end, new fields get their default in
+ * dmlDefaultOptions.
+ */
+
+#ifndef API_DMLAPI_H_
+#define API_DMLAPI_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DML_API_VERSION 1
+
+/**
+ * status of the calls, the message of the last error of the calling thread
+ * is given by dmlLastError
+ */
+enum DmlStatus {
+	DML_OK = 0,
+	DML_INVALID_ARGUMENT = -1,
+	DML_CLUSTERING_FAILED = -2
+};
+
+/**
+ * the algorithms of ml.cpp (property algo)
+ */
+enum DmlAlgorithm {
+	DML_PCKMEANS_NOMETRIC = 0,
+	DML_MPCKMEANS_GLOBAL_DIAGONAL = 1,
+	DML_MPCKMEANS_GLOBAL_FULL = 2,
+	DML_MPCKMEANS_LOCAL_DIAGONAL = 3,
+	DML_MPCKMEANS_LOCAL_FULL = 4,
+	DML_MPCKMEANS_GLOBAL_LOWRANK = 5,
+	DML_MPCKMEANS_LOCAL_LOWRANK = 6
+};
+
+/**
+ * DML_PRECISION_FLOAT and DML_PRECISION_DOUBLE read the data set in place,
+ * DML_PRECISION_HALF converts it once per call
+ */
+enum DmlPrecision {
+	DML_PRECISION_FLOAT = 0,	// float storage and accumulation
+	DML_PRECISION_DOUBLE = 1,	// float storage, double accumulation
+	DML_PRECISION_HALF = 2		// half storage, float accumulation
+};
+
+/**
+ * the params of one run, the names of the properties file in comment
+ */
+typedef struct DmlOptions {
+	int algorithm;				// algo, a DmlAlgorithm
+	int numClusters;			// numberClusters
+	int maxIteration;			// maxIteration
+	float minObjFuncChange;		// minObjectiveFunctionChange
+	int precision;				// precision, a DmlPrecision
+	int numThreads;				// numberThreadsPerRun, 0 = one per core
+	int onlineUpdate;			// onlineUpdate
+	int diameterSweep;			// diameterEstimator: 0 = exact, 1 = sweep
+	int constraintComponents;	// constraintModel: 0 = pairs, 1 = components
+	int boundPruning;			// boundPruning
+	int centerIndex;			// centerIndex
+	int miniBatchSize;			// miniBatchSize, 0 = full batch
+	unsigned seed;				// seed of the random engine of the call, 0 = random
+	int metricRank;				// metricRank, eigenpairs of the LOWRANK metrics
+	// progress messages (one line each), NULL = silent; called from the
+	// threads of the call when numThreads != 1
+	void (*logCallback)(const char* message, void* userData);
+	void* logUserData;			// passed back to logCallback
+} DmlOptions;
+
+/**
+ * the EMResult of a run
+ */
+typedef struct DmlResult {
+	int iterations;
+	float cost;
+	int reachLocalMinimal;
+	int numMLViolation;
+	int numCLViolation;
+	double numDistEvaluated;	// exact up to 2^53
+	double numDistSkipped;
+} DmlResult;
+
+/**
+ * the values of config/default.propertites: PCKMEANS_NOMETRIC, 10 clusters,
+ * 20 iterations, minimum change 0.01, float, 1 thread, rank 32, silent
+ */
+void dmlDefaultOptions(DmlOptions* options);
+
+/**
+ * cluster the data set and write the cluster of each point into assignment
+ * data: nDims x nData floats, the dimensions of one point are contiguous
+ *     (column-major, one column is one point); ml.cpp centers the data set
+ *     before clustering it, the caller does it here if needed
+ * mustLinks, cannotLinks: pairs of point indices (idx1, idx2, idx1, idx2...),
+ *     2 x numMustLinks and 2 x numCannotLinks ints, may be null when empty;
+ *     the components are derived from the must-links (no .scc file)
+ * assignment: nData ints, written only on success
+ * result: may be null
+ * the call is blocking, concurrent calls on different buffers are allowed:
+ * each call has its own random engine (options->seed), the process wide
+ * std::rand is neither seeded nor read
+ */
+int dmlCluster(const float* data, int nDims, int nData,
+	const int* mustLinks, int numMustLinks,
+	const int* cannotLinks, int numCannotLinks,
+	const DmlOptions* options, int* assignment, DmlResult* result);
+
+/**
+ * the message of the last failed call of this thread, "" if none; valid
+ * until the next call of dmlCluster on this thread
+ */
+const char* dmlLastError(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* API_DMLAPI_H_ */
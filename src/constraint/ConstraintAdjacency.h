@@ -0,0 +1,114 @@
+/*
+ * ConstraintAdjacency.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Refined constraints (ML or CL) frozen into a compressed sparse row structure:
+ * the neighbors of point idx are adjacent[offsets[idx] .. offsets[idx + 1]),
+ * sorted by increasing id, without duplicate nor self link.
+ * Every link is stored in both directions.
+ */
+
+#ifndef CONSTRAINT_CONSTRAINTADJACENCY_H_
+#define CONSTRAINT_CONSTRAINTADJACENCY_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace dml {
+
+class ConstraintAdjacency {
+public:
+	/**
+	 * neighbors of one point, usable in range-based for
+	 */
+	struct Range {
+		const int* first = nullptr;
+		const int* last = nullptr;
+		int offset = 0;		// position of first in the adjacent array
+		const int* begin() const { return first; }
+		const int* end() const { return last; }
+		int size() const { return (int) (last - first); }
+		bool empty() const { return first == last; }
+	};
+
+	ConstraintAdjacency() : offsets(1, 0) {}
+
+	/**
+	 * build from a list of (undirected) links, nPoints is at least max id + 1
+	 */
+	void build(const std::vector<std::pair<int, int> >& links, int nPoints) {
+		for (const auto& link : links) {
+			nPoints = std::max(nPoints, std::max(link.first, link.second) + 1);
+		}
+
+		// count degrees, then fill each row at its offset
+		offsets.assign(nPoints + 1, 0);
+		for (const auto& link : links) {
+			if (link.first == link.second) continue;
+			offsets[link.first + 1]++;
+			offsets[link.second + 1]++;
+		}
+		for (int idx = 0; idx < nPoints; ++idx) {
+			offsets[idx + 1] += offsets[idx];
+		}
+		adjacent.resize(offsets[nPoints]);
+		std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+		for (const auto& link : links) {
+			if (link.first == link.second) continue;
+			adjacent[cursor[link.first]++] = link.second;
+			adjacent[cursor[link.second]++] = link.first;
+		}
+
+		// sort and remove duplicated links, compacting rows in place
+		int writePos = 0;
+		for (int idx = 0; idx < nPoints; ++idx) {
+			auto rowBegin = adjacent.begin() + offsets[idx];
+			auto rowEnd = adjacent.begin() + offsets[idx + 1];
+			std::sort(rowBegin, rowEnd);
+			auto uniqueEnd = std::unique(rowBegin, rowEnd);
+			offsets[idx] = writePos;
+			writePos = std::copy(rowBegin, uniqueEnd, adjacent.begin() + writePos) - adjacent.begin();
+		}
+		offsets[nPoints] = writePos;
+		adjacent.resize(writePos);
+		adjacent.shrink_to_fit();
+	}
+
+	Range neighbors(const int idx) const {
+		Range range;
+		if (idx >= 0 && idx < numPoints()) {
+			range.first = adjacent.data() + offsets[idx];
+			range.last = adjacent.data() + offsets[idx + 1];
+			range.offset = offsets[idx];
+		}
+		return range;
+	}
+
+	/**
+	 * position of the link (idx1, idx2) in the adjacent array, -1 if no link
+	 */
+	int linkIndex(const int idx1, const int idx2) const {
+		Range range = neighbors(idx1);
+		const int* pos = std::lower_bound(range.first, range.last, idx2);
+		return (pos != range.last && *pos == idx2) ? (int) (pos - adjacent.data()) : -1;
+	}
+
+	// number of points covered by the offsets (max constrained id + 1)
+	int numPoints() const { return (int) offsets.size() - 1; }
+
+	// number of stored links, each constraint is counted in both directions
+	int numLinks() const { return (int) adjacent.size(); }
+
+	bool hasLinks(const int idx) const { return !neighbors(idx).empty(); }
+
+private:
+	std::vector<int> offsets;
+	std::vector<int> adjacent;
+};
+
+} /* namespace dml */
+
+#endif /* CONSTRAINT_CONSTRAINTADJACENCY_H_ */
@@ -0,0 +1,99 @@
+/*
+ * ConstraintColoring.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Greedy coloring of the constraint graph ML u CL: two points of the same
+ * color share no constraint, so the cost of assigning one of them does not
+ * depend on the assignment of the others and all points of one color can be
+ * assigned concurrently. Points without any constraint are not colored.
+ */
+
+#ifndef CONSTRAINT_CONSTRAINTCOLORING_H_
+#define CONSTRAINT_CONSTRAINTCOLORING_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "ConstraintAdjacency.h"
+
+namespace dml {
+
+class ConstraintColoring {
+public:
+	static constexpr int UNCOLORED = -1;
+
+	ConstraintColoring() : colorOffsets(1, 0) {}
+
+	/**
+	 * first-fit coloring, the points are visited by decreasing degree
+	 * (Welsh-Powell) which keeps the number of colors low
+	 */
+	void build(const ConstraintAdjacency& ML, const ConstraintAdjacency& CL) {
+		int nPoints = std::max(ML.numPoints(), CL.numPoints());
+		std::vector<int> order;
+		std::vector<int> degree(nPoints, 0);
+		for (int idx = 0; idx < nPoints; ++idx) {
+			degree[idx] = ML.neighbors(idx).size() + CL.neighbors(idx).size();
+			if (degree[idx] > 0) order.push_back(idx);
+		}
+		std::stable_sort(order.begin(), order.end(),
+			[&](int a, int b) { return degree[a] > degree[b]; });
+
+		// seenBy[c] == idx when a neighbor of idx already has color c
+		colors.assign(nPoints, UNCOLORED);
+		std::vector<int> seenBy;
+		for (const int& idx : order) {
+			for (const ConstraintAdjacency* links : {&ML, &CL}) {
+				for (const int& other : links->neighbors(idx)) {
+					if (UNCOLORED != colors[other]) seenBy[colors[other]] = idx;
+				}
+			}
+			int color = 0;
+			while (color < (int) seenBy.size() && idx == seenBy[color]) ++color;
+			if (color == (int) seenBy.size()) seenBy.push_back(UNCOLORED);
+			colors[idx] = color;
+		}
+
+		// group the points by color, in increasing id inside one color
+		int nColors = (int) seenBy.size();
+		colorOffsets.assign(nColors + 1, 0);
+		for (const int& idx : order) {
+			colorOffsets[colors[idx] + 1]++;
+		}
+		for (int color = 0; color < nColors; ++color) {
+			colorOffsets[color + 1] += colorOffsets[color];
+		}
+		members.resize(order.size());
+		std::vector<int> cursor(colorOffsets.begin(), colorOffsets.end() - 1);
+		for (int idx = 0; idx < nPoints; ++idx) {
+			if (UNCOLORED != colors[idx]) members[cursor[colors[idx]]++] = idx;
+		}
+	}
+
+	int numColors() const { return (int) colorOffsets.size() - 1; }
+
+	int numColored() const { return (int) members.size(); }
+
+	// UNCOLORED for a point without constraint
+	int colorOf(const int idx) const {
+		return (idx < (int) colors.size()) ? colors[idx] : UNCOLORED;
+	}
+
+	/**
+	 * the points of one color are [begin(color), end(color))
+	 */
+	const int* begin(const int color) const { return members.data() + colorOffsets[color]; }
+	const int* end(const int color) const { return members.data() + colorOffsets[color + 1]; }
+	int size(const int color) const { return colorOffsets[color + 1] - colorOffsets[color]; }
+
+private:
+	std::vector<int> colors;
+	std::vector<int> colorOffsets;
+	std::vector<int> members;
+};
+
+} /* namespace dml */
+
+#endif /* CONSTRAINT_CONSTRAINTCOLORING_H_ */
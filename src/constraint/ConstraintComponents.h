@@ -0,0 +1,121 @@
+/*
+ * ConstraintComponents.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Constraints at the level of groups of points: the must-link components
+ * (a point with cannot-links only is a component of its own) and the
+ * cannot-links between components. A group of n points linked to a group of
+ * m points is n ids and one link, instead of n^2 / 2 + n * m expanded pairs.
+ */
+
+#ifndef CONSTRAINT_CONSTRAINTCOMPONENTS_H_
+#define CONSTRAINT_CONSTRAINTCOMPONENTS_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "ConstraintAdjacency.h"
+#include "../utils/graphUtils.h"
+
+namespace dml {
+
+class ConstraintComponents {
+public:
+	static constexpr int NO_COMPONENT = -1;
+
+	ConstraintComponents() : offsets(1, 0) {}
+
+	/**
+	 * groups: the points of each component (disjoint)
+	 * groupLinks: cannot-links between two groups (indices in groups)
+	 */
+	void build(const std::vector<std::vector<int> >& groups,
+		const std::vector<std::pair<int, int> >& groupLinks, int nPoints) {
+		for (const auto& group : groups) {
+			for (const int& idx : group) nPoints = std::max(nPoints, idx + 1);
+		}
+		compOf.assign(nPoints, NO_COMPONENT);
+		offsets.assign(1, 0);
+		memberIds.clear();
+		for (const auto& group : groups) {
+			for (const int& idx : group) {
+				compOf[idx] = (int) offsets.size() - 1;
+				memberIds.push_back(idx);
+			}
+			offsets.push_back((int) memberIds.size());
+		}
+		compCL.build(groupLinks, numComponents());
+	}
+
+	/**
+	 * from expanded links: the components of ML (union-find) and the CL
+	 * collapsed on them, a CL inside a component is dropped
+	 */
+	void build(const ConstraintAdjacency& ML, const ConstraintAdjacency& CL) {
+		int nPoints = std::max(ML.numPoints(), CL.numPoints());
+		UnionFind sets(nPoints);
+		for (int idx1 = 0; idx1 < ML.numPoints(); ++idx1) {
+			for (const int& idx2 : ML.neighbors(idx1)) sets.unite(idx1, idx2);
+		}
+		std::vector<std::vector<int> > groups;
+		std::vector<int> groupOfRoot(nPoints, NO_COMPONENT);
+		for (int idx = 0; idx < nPoints; ++idx) {
+			if (!ML.hasLinks(idx) && !CL.hasLinks(idx)) continue;
+			int root = sets.find(idx);
+			if (NO_COMPONENT == groupOfRoot[root]) {
+				groupOfRoot[root] = (int) groups.size();
+				groups.push_back(std::vector<int>());
+			}
+			groups[groupOfRoot[root]].push_back(idx);
+		}
+
+		std::vector<std::pair<int, int> > groupLinks;
+		for (int idx1 = 0; idx1 < CL.numPoints(); ++idx1) {
+			int group1 = groupOfRoot[sets.find(idx1)];
+			for (const int& idx2 : CL.neighbors(idx1)) {
+				int group2 = groupOfRoot[sets.find(idx2)];
+				if (group1 < group2) groupLinks.push_back(std::make_pair(group1, group2));
+			}
+		}
+		build(groups, groupLinks, nPoints);
+	}
+
+	int numComponents() const { return (int) offsets.size() - 1; }
+
+	// NO_COMPONENT for a point without constraint
+	int componentOf(const int idx) const {
+		return (idx < (int) compOf.size()) ? compOf[idx] : NO_COMPONENT;
+	}
+
+	/**
+	 * the points of one component, usable in range-based for
+	 */
+	ConstraintAdjacency::Range members(const int comp) const {
+		ConstraintAdjacency::Range range;
+		range.first = memberIds.data() + offsets[comp];
+		range.last = memberIds.data() + offsets[comp + 1];
+		range.offset = offsets[comp];
+		return range;
+	}
+
+	int size(const int comp) const { return offsets[comp + 1] - offsets[comp]; }
+
+	// the components cannot-linked to comp
+	ConstraintAdjacency::Range cannotLinked(const int comp) const { return compCL.neighbors(comp); }
+
+	// number of cannot-links between components, counted in both directions
+	int numComponentLinks() const { return compCL.numLinks(); }
+
+private:
+	std::vector<int> compOf;
+	std::vector<int> offsets;
+	std::vector<int> memberIds;
+	ConstraintAdjacency compCL;
+};
+
+} /* namespace dml */
+
+#endif /* CONSTRAINT_CONSTRAINTCOMPONENTS_H_ */
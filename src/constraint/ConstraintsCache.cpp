@@ -0,0 +1,112 @@
+/*
+ * ConstraintsCache.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ */
+
+#include "ConstraintsCache.h"
+
+#include <algorithm>
+
+#include <sys/stat.h>
+
+namespace dml {
+
+ConstraintsCache& ConstraintsCache::instance() {
+	static ConstraintsCache cache;
+	return cache;
+}
+
+ConstraintPtr ConstraintsCache::get(const std::string& fileName) {
+	std::string stamp = modificationStamp(fileName);
+	std::promise<ConstraintPtr> promise;
+	std::shared_future<ConstraintPtr> future;
+	bool isLoader = false;
+	unsigned long loadId = 0;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = entries.find(fileName);
+		if (entries.end() != it && it->second.stamp == stamp) {
+			it->second.lastUse = ++useCount;
+			future = it->second.constraints;
+		} else {
+			// this thread parses the file, the others wait on the future
+			Entry entry;
+			entry.stamp = stamp;
+			entry.constraints = promise.get_future().share();
+			future = entry.constraints;
+			entry.lastUse = ++useCount;
+			entry.loadId = loadId = entry.lastUse;
+			// replaces the entry of an older stamp
+			entries[fileName] = entry;
+			evict();
+			isLoader = true;
+		}
+	}
+	if (!isLoader) {
+		return future.get();
+	}
+
+	try {
+		promise.set_value(load(fileName));
+	} catch (...) {
+		promise.set_exception(std::current_exception());
+		// only this parse: another thread may have replaced the entry since
+		std::lock_guard<std::mutex> guard(lock);
+		auto it = entries.find(fileName);
+		if (entries.end() != it && it->second.loadId == loadId) {
+			entries.erase(it);
+		}
+	}
+	return future.get();
+}
+
+void ConstraintsCache::clear() {
+	std::lock_guard<std::mutex> guard(lock);
+	entries.clear();
+}
+
+int ConstraintsCache::size() {
+	std::lock_guard<std::mutex> guard(lock);
+	return (int) entries.size();
+}
+
+void ConstraintsCache::setCapacity(const int maxEntries) {
+	std::lock_guard<std::mutex> guard(lock);
+	capacity = std::max(1, maxEntries);
+	evict();
+}
+
+void ConstraintsCache::evict() {
+	while ((int) entries.size() > capacity) {
+		auto oldest = entries.begin();
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			if (it->second.lastUse < oldest->second.lastUse) oldest = it;
+		}
+		entries.erase(oldest);
+	}
+}
+
+ConstraintPtr ConstraintsCache::load(const std::string& fileName) {
+	std::shared_ptr<ConstraintsManager> constraints(new ConstraintsManager(fileName));
+	constraints->readConstraintsFromFile();
+	constraints->readConnectedComponents();
+	return constraints;
+}
+
+std::string ConstraintsCache::modificationStamp(const std::string& fileName) {
+	std::string stamp;
+	for (const std::string ext : {".links", ".scc"}) {
+		struct stat st;
+		if (0 == stat((fileName + ext).c_str(), &st)) {
+			stamp += std::to_string(st.st_mtim.tv_sec) + "." +
+				std::to_string(st.st_mtim.tv_nsec) + ";";
+		} else {
+			stamp += "-;";
+		}
+	}
+	return stamp;
+}
+
+} /* namespace dml */
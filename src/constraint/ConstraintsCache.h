@@ -0,0 +1,68 @@
+/*
+ * ConstraintsCache.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Parse each constraint file (.links + optional .scc) once and share the refined
+ * constraint set, read-only, between all the runs that use it.
+ */
+
+#ifndef CONSTRAINT_CONSTRAINTSCACHE_H_
+#define CONSTRAINT_CONSTRAINTSCACHE_H_
+
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "ConstraintsManager.h"
+
+namespace dml {
+
+class ConstraintsCache {
+public:
+	static ConstraintsCache& instance();
+
+	/**
+	 * get the refined constraints of a constraint file (name without extension).
+	 * The file is parsed at the first request, or again if the .links or .scc
+	 * file was modified since. Concurrent requests for the same file wait for
+	 * a single parse. Beyond the capacity, the least recently requested file
+	 * is dropped (the runs holding its constraints keep them).
+	 */
+	ConstraintPtr get(const std::string& fileName);
+
+	void clear();
+	int size();
+	void setCapacity(const int maxEntries);
+
+	const static int DEFAULT_CAPACITY = 16;
+
+private:
+	ConstraintsCache() {}
+	ConstraintsCache(const ConstraintsCache&) = delete;
+	ConstraintsCache& operator=(const ConstraintsCache&) = delete;
+
+	static ConstraintPtr load(const std::string& fileName);
+	static std::string modificationStamp(const std::string& fileName);
+
+	struct Entry {
+		std::string stamp;	// modification times of .links and .scc
+		std::shared_future<ConstraintPtr> constraints;
+		unsigned long loadId = 0;	// the parse that fills constraints
+		unsigned long lastUse = 0;
+	};
+
+	// drop the least recently used entries above the capacity, lock held
+	void evict();
+
+	std::mutex lock;
+	std::map<std::string, Entry> entries;
+	unsigned long useCount = 0;
+	int capacity = DEFAULT_CAPACITY;
+};
+
+} /* namespace dml */
+
+#endif /* CONSTRAINT_CONSTRAINTSCACHE_H_ */
@@ -13,8 +13,11 @@
 #include <iterator>
 #include <iostream>
 #include <utility>
-#include <cassert>
+#include <algorithm>
+#include <stdexcept>
 #include "../utils/functionUtils.h"
+#include "../utils/textLoader.h"
+#include "../utils/graphUtils.h"
 #include "InitManager.h"
 
 namespace dml {
@@ -27,7 +30,10 @@ ConstraintsManager::~ConstraintsManager() {}
 void ConstraintsManager::readConnectedComponents() {
 	std::string fileSCC = fileName + ".scc";
 	std::ifstream infile(fileSCC.c_str());
-	assert(infile.is_open() && "Can not open SCC file");
+	if (!infile.is_open()) {
+		deriveConnectedComponents();
+		return;
+	}
 
 	std::string line;
 	while(std::getline(infile, line)) {
@@ -40,47 +46,78 @@ void ConstraintsManager::readConnectedComponents() {
 	infile.close();
 }
 
+void ConstraintsManager::deriveConnectedComponents() {
+	// the same order as the .scc files: components by smallest point id,
+	// the points of one component in decreasing id
+	UnionFind components(ML.numPoints());
+	for (int idx1 = 0; idx1 < ML.numPoints(); ++idx1) {
+		for (const int& idx2 : ML.neighbors(idx1)) {
+			components.unite(idx1, idx2);
+		}
+	}
+	scc = components.components();
+}
+
 void ConstraintsManager::readConstraintsFromFile() {
 	std::string fileLinks = fileName + ".links";
-	std::ifstream infile(fileLinks.c_str());
-	assert(infile.is_open() && "Can not open Constraints file");
-
-	int nodeA = 0, nodeB = 0, nodeType = 0;
-	infile >> nConstraintsOriginal >> nConstraintsDeduced;
+	// throws when the file can not be opened
+	TextLoader loader(fileLinks);
+	nConstraintsOriginal = loader.readHeaderToken<int>();
+	nConstraintsDeduced = loader.readHeaderToken<int>();
+
+	// each constraint is a triple (nodeA, nodeB, nodeType)
+	size_t nValues = 3 * (size_t) nConstraintsDeduced;
+	if (loader.countBodyTokens() < nValues) {
+		throw std::runtime_error("Missing constraints in file: " + fileLinks);
+	}
+	std::vector<int> triples(nValues);
+	loader.parseBody<int>([&](size_t tokenIdx, int value) {
+		if (tokenIdx < nValues) {
+			triples[tokenIdx] = value;
+		}
+	});
+	loadStats = loader.getStats();
 
-	for (int i = 0; i < nConstraintsDeduced; ++i) {
-		infile >> nodeA >> nodeB >> nodeType;
+	std::vector<std::pair<int, int> > mlLinks, clLinks;
+	for (size_t i = 0; i < nValues; i += 3) {
+		int nodeA = triples[i], nodeB = triples[i + 1], nodeType = triples[i + 2];
 
 		if (MUST_LINK == nodeType) {
-			ML[nodeA].push_back(nodeB);
-			ML[nodeB].push_back(nodeA);
+			mlLinks.push_back(std::make_pair(nodeA, nodeB));
 		} else if (CANNOT_LINK == nodeType) {
-			CL[nodeA].push_back(nodeB);
-			CL[nodeB].push_back(nodeA);
+			clLinks.push_back(std::make_pair(nodeA, nodeB));
 		}
 	}
-	infile.close();
-	refineConstraints();
+	refineConstraints(mlLinks, clLinks);
 }
 
-void ConstraintsManager::refineConstraints() {
-	numML = refineAndCount(ML);
-	numCL = refineAndCount(CL);
+void ConstraintsManager::refineConstraints(const std::vector<std::pair<int, int> >& mlLinks,
+	const std::vector<std::pair<int, int> >& clLinks) {
+	// both sets cover the same range of point ids
+	int nPoints = 0;
+	for (const auto& links : {&mlLinks, &clLinks}) {
+		for (const auto& link : *links) {
+			nPoints = std::max(nPoints, std::max(link.first, link.second) + 1);
+		}
+	}
+	ML.build(mlLinks, nPoints);
+	CL.build(clLinks, nPoints);
+	coloring.build(ML, CL);
+	components.build(ML, CL);
+	numML = ML.numLinks();
+	numCL = CL.numLinks();
 }
 
-int ConstraintsManager::refineAndCount(ConstraintMap& constraintsMap) {
-	int nCount = 0;
-	for (auto& it : constraintsMap) {
-		int key = it.first;
-		it.second.sort();
-		it.second.unique();
-		it.second.remove(key);
-		nCount += it.second.size();
+void ConstraintsManager::refineComponentConstraints(const std::vector<std::vector<int> >& groups,
+	const std::vector<std::pair<int, int> >& groupLinks) {
+	components.build(groups, groupLinks, 0);
+	scc.clear();
+	for (const auto& group : groups) {
+		if (group.size() > 1) scc.push_back(group);
 	}
-	return nCount;
 }
 
-void ConstraintsManager::dumpConstraints() {
+void ConstraintsManager::dumpConstraints() const {
 	std::cout << "MUST LINKS: " << std::endl;
 	dumpConstraints (ML);
 
@@ -88,11 +125,12 @@ void ConstraintsManager::dumpConstraints() {
 	dumpConstraints (CL);
 }
 
-void ConstraintsManager::dumpConstraints(const ConstraintMap& constraintsMap) {
-	for (const auto& it : constraintsMap) {
-		std::cout << it.first << " => ( ";
-		for (const auto& it2 : it.second) {
-			std::cout << it2 << ", ";
+void ConstraintsManager::dumpConstraints(const ConstraintAdjacency& constraints) const {
+	for (int idx = 0; idx < constraints.numPoints(); ++idx) {
+		if (!constraints.hasLinks(idx)) continue;
+		std::cout << idx << " => ( ";
+		for (const int& idx2 : constraints.neighbors(idx)) {
+			std::cout << idx2 << ", ";
 		}
 		std::cout << ")\n";
 	}
@@ -100,7 +138,9 @@ void ConstraintsManager::dumpConstraints(const ConstraintMap& constraintsMap) {
 
 using namespace Eigen;
 
-MatrixXf ConstraintsManager::genInitCentersFromML(const Ref<const MatrixXf>& X, int nClusters) {
+template <typename Storage>
+MatrixXf ConstraintsManager::genInitCentersFromML(const Ref<const MatrixX<Storage> >& X, int nClusters,
+	std::mt19937& engine) const {
 	int nDims = X.rows();
 	int nComps = scc.size();
 
@@ -108,17 +148,18 @@ MatrixXf ConstraintsManager::genInitCentersFromML(const Ref<const MatrixXf>& X,
 	InitManager initMgnr(nDims, nClusters);
 
 	if (0 == nComps) {
-		initMgnr.fillWithTotalRandomInit(X, initCenters);
+		initMgnr.fillWithTotalRandomInit(X, initCenters, engine);
 	} else { 
-		MatrixXf compCentroids = getComponentCenters(X);
+		MatrixXf compCentroids = getComponentCenters<Storage>(X);
 		if (nComps <= nClusters) {
 			for (int compId = 0; compId < nComps; ++compId) {
 				initCenters.col(compId) = compCentroids.col(compId);
 			}
 			if (nComps < nClusters) {
-				VectorXf globalMean = X.rowwise().mean();
+				VectorXf globalMean = X.template cast<float>().rowwise().mean();
+				std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
 				for (int compId = nComps; compId < nClusters; ++compId) {
-					initCenters.col(compId) = globalMean + VectorXf::Random(nDims);
+					initCenters.col(compId) = globalMean + VectorXf::NullaryExpr(nDims, [&]() { return uniform(engine); });
 				}
 			}
 		} else {
@@ -129,7 +170,8 @@ MatrixXf ConstraintsManager::genInitCentersFromML(const Ref<const MatrixXf>& X,
 	return initCenters;
 }
 
-MatrixXf ConstraintsManager::getComponentCenters(const Ref<const MatrixXf>& X) {
+template <typename Storage>
+MatrixXf ConstraintsManager::getComponentCenters(const Ref<const MatrixX<Storage> >& X) const {
 	int nDims = X.rows();
 	int nComps = (int)scc.size();
 	MatrixXf compCentroids = MatrixXf::Zero(nDims, nComps);
@@ -141,14 +183,19 @@ MatrixXf ConstraintsManager::getComponentCenters(const Ref<const MatrixXf>& X) {
 		MatrixXf oneCompData(nDims, oneCompSize);
 		for (int idx = 0; idx < oneCompSize; ++idx) {
 			int dataIndex = scc.at(compId).at(idx);
-			oneCompData.col(idx) = X.col(dataIndex);
+			oneCompData.col(idx) = X.col(dataIndex).template cast<float>();
 		}
 		compCentroids.col(compId) = oneCompData.rowwise().mean();
 	}
 	return compCentroids;
 }
 
-std::vector<float> ConstraintsManager::getComponentWeights() {
+template MatrixXf ConstraintsManager::genInitCentersFromML<float>(
+	const Ref<const MatrixXf>& X, int nClusters, std::mt19937& engine) const;
+template MatrixXf ConstraintsManager::genInitCentersFromML<Eigen::half>(
+	const Ref<const MatrixX<Eigen::half> >& X, int nClusters, std::mt19937& engine) const;
+
+std::vector<float> ConstraintsManager::getComponentWeights() const {
 	float sumWeight = 0.0f;
 	std::vector<float> weights;
 	for (const auto& v : scc) {
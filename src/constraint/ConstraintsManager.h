@@ -10,24 +10,36 @@
 #ifndef PCKMEANS_CONSTRAINTSMANAGER_H_
 #define PCKMEANS_CONSTRAINTSMANAGER_H_
 
-#include <list>
-#include <map>
 #include <vector>
 #include <string>
 #include <memory>
+#include <random>
+#include <utility>
 #include "../utils/Eigen3.h"
+#include "../utils/textLoader.h"
+#include "ConstraintAdjacency.h"
+#include "ConstraintColoring.h"
+#include "ConstraintComponents.h"
 
 namespace dml {
 
-typedef std::map<int, std::list<int> > ConstraintMap;
+/**
+ * CONSTRAINT_PAIRS: penalties and impacts summed over the expanded links
+ * CONSTRAINT_COMPONENTS: summed over the components and their cannot-links
+ */
+enum ConstraintModel {
+	CONSTRAINT_PAIRS, CONSTRAINT_COMPONENTS
+};
 
 class ConstraintsManager {
 public:
 	ConstraintsManager(std::string inputFileName);
 	virtual ~ConstraintsManager();
 
-	ConstraintMap ML;
-	ConstraintMap CL;
+	ConstraintAdjacency ML;
+	ConstraintAdjacency CL;
+	ConstraintColoring coloring;	// of ML u CL, for the parallel E-step
+	ConstraintComponents components;	// ML components and the CL between them
 
 	float mlConst = 0.05f;
 	float clConst = 0.05f;
@@ -35,19 +47,34 @@ public:
 	int numCL = 0;
 	int nConstraintsOriginal = 0;
 	int nConstraintsDeduced = 0;
+	LoadStats loadStats;		// parse statistic of the .links file
 
 	void readConstraintsFromFile();
-	void refineConstraints();
-	int refineAndCount(ConstraintMap& constraintsMap);
-	void dumpConstraints();
-	void dumpConstraints(const ConstraintMap& constraintsMap);
+	void refineConstraints(const std::vector<std::pair<int, int> >& mlLinks,
+		const std::vector<std::pair<int, int> >& clLinks);
+	/**
+	 * constraints given as groups of must-linked points and cannot-links
+	 * between groups (indices in groups), without expanding them into pairs:
+	 * only the CONSTRAINT_COMPONENTS model sees them
+	 */
+	void refineComponentConstraints(const std::vector<std::vector<int> >& groups,
+		const std::vector<std::pair<int, int> >& groupLinks);
+	void dumpConstraints() const;
+	void dumpConstraints(const ConstraintAdjacency& constraints) const;
 
 	std::vector<std::vector<int> > scc;//strongly connected component
 
+	// read scc from the .scc file, or derive it when there is no such file
 	void readConnectedComponents();
-	Eigen::MatrixXf genInitCentersFromML(const Eigen::Ref<const Eigen::MatrixXf>& X, int nClusters);
-	Eigen::MatrixXf getComponentCenters(const Eigen::Ref<const Eigen::MatrixXf>& X);
-	std::vector<float> getComponentWeights();
+	// scc = the must-link components (union-find over ML, O(V + E))
+	void deriveConnectedComponents();
+	// Storage: scalar of X (float, Eigen::half), the centers are float
+	template <typename Storage>
+	Eigen::MatrixXf genInitCentersFromML(const Eigen::Ref<const Eigen::MatrixX<Storage> >& X, int nClusters,
+		std::mt19937& engine) const;
+	template <typename Storage>
+	Eigen::MatrixXf getComponentCenters(const Eigen::Ref<const Eigen::MatrixX<Storage> >& X) const;
+	std::vector<float> getComponentWeights() const;
 
 private:
 	std::string fileName;
@@ -55,7 +82,8 @@ private:
 	static const int CANNOT_LINK = -1;
 };
 
-typedef std::shared_ptr<ConstraintsManager> ConstraintPtr;
+// once refined, a constraint set is shared read-only (see ConstraintsCache)
+typedef std::shared_ptr<const ConstraintsManager> ConstraintPtr;
 
 } /* namespace dml */
 
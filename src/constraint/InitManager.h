@@ -12,6 +12,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <random>
 #include "../utils/Eigen3.h"
 #include "../utils/functionUtils.h"
 
@@ -25,12 +26,13 @@ public:
 	InitManager(int dim, int numClts) : nDims(dim), nClusters(numClts) {}
 	~InitManager() {}
 
-	void fillWithTotalRandomInit(const Ref<const MatrixXf>& X, MatrixXf& initCenters) {
+	template <typename Derived>
+	void fillWithTotalRandomInit(const MatrixBase<Derived>& X, MatrixXf& initCenters, std::mt19937& engine) {
 		int nData = X.cols();
 		int nEstimate = nData / nClusters;
 		for (int cltId = 0; cltId < nClusters; ++cltId) {
-			int rndIdx = cltId * nEstimate + randomInRange(0, nEstimate);
-			initCenters.col(cltId) = X.col(rndIdx);
+			int rndIdx = cltId * nEstimate + randomInRange(0, nEstimate, engine);
+			initCenters.col(cltId) = X.col(rndIdx).template cast<float>();
 		}
 	}
 
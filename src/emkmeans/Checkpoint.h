@@ -0,0 +1,257 @@
+/*
+ * Checkpoint.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Binary checkpoint of a ClusteringState, to resume a run after a crash or
+ * on another machine. The file is mmap-ed on restore and every section is
+ * read through an Eigen::Map, so loading a model does not parse anything.
+ *
+ * Layout, each section starts on a CHECKPOINT_ALIGN boundary:
+ *   [CheckpointHeader, padded to CHECKPOINT_HEADER_SIZE bytes]
+ *   vAssign    int32 x nData
+ *   objFuncs   float x nObjFuncs
+ *   visitOrder int32 x nData
+ *   means      float x (nDims x nClusters), one column is one mean
+ *   logDets    float x nMetrics
+ *   metricDims uint32 x (2 x nMetrics): length of covDiag, rows of rotation
+ *   metrics    float: covDiag then rotation (rows x nDims, column-major) of each metric
+ *   rngState   char x nRngBytes: the random engine of the run, as text
+ */
+
+#ifndef EMKMEANS_CHECKPOINT_H_
+#define EMKMEANS_CHECKPOINT_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ClusteringState.h"
+#include "../utils/Eigen3.h"
+#include "../utils/matrixFile.h"
+
+namespace dml {
+
+const static char CHECKPOINT_MAGIC[8] = {'D', 'M', 'L', 'C', 'K', 'P', 'T', '\0'};
+const static uint32_t CHECKPOINT_VERSION = 2;
+const static size_t CHECKPOINT_HEADER_SIZE = 128;
+const static size_t CHECKPOINT_ALIGN = 64;
+
+struct CheckpointHeader {
+	char magic[8];
+	uint32_t version = CHECKPOINT_VERSION;
+	uint32_t nRngBytes = 0;
+	uint64_t nData = 0;
+	uint64_t nDims = 0;
+	uint64_t nClusters = 0;
+	uint64_t nMetrics = 0;
+	uint64_t nObjFuncs = 0;
+	uint64_t nMetricValues = 0;	// floats in the metrics section
+	int64_t currIter = 0;
+	uint64_t fileSize = 0;
+	uint64_t checksum = 0;		// FNV-1a of everything after the header
+};
+
+static_assert(sizeof(CheckpointHeader) <= CHECKPOINT_HEADER_SIZE, "Header too big");
+
+/**
+ * offsets of the sections, from the sizes in the header
+ */
+struct CheckpointLayout {
+	explicit CheckpointLayout(const CheckpointHeader& header) {
+		size_t offset = CHECKPOINT_HEADER_SIZE;
+		assign = offset;
+		offset = align(offset + header.nData * sizeof(int32_t));
+		objFuncs = offset;
+		offset = align(offset + header.nObjFuncs * sizeof(float));
+		visitOrder = offset;
+		offset = align(offset + header.nData * sizeof(int32_t));
+		means = offset;
+		offset = align(offset + header.nDims * header.nClusters * sizeof(float));
+		logDets = offset;
+		offset = align(offset + header.nMetrics * sizeof(float));
+		metricDims = offset;
+		offset = align(offset + 2 * header.nMetrics * sizeof(uint32_t));
+		metrics = offset;
+		offset = align(offset + header.nMetricValues * sizeof(float));
+		rngState = offset;
+		fileSize = offset + header.nRngBytes;
+	}
+
+	static size_t align(const size_t offset) {
+		return (offset + CHECKPOINT_ALIGN - 1) / CHECKPOINT_ALIGN * CHECKPOINT_ALIGN;
+	}
+
+	size_t assign, objFuncs, visitOrder, means, logDets, metricDims, metrics, rngState, fileSize;
+};
+
+/**
+ * Write the state into fileName. The file is written next to it then
+ * renamed, so a crash while writing leaves the previous checkpoint intact.
+ */
+inline void writeCheckpoint(const std::string& fileName, const ClusteringState& state) {
+	CheckpointHeader header;
+	std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+	header.nRngBytes = (uint32_t) state.rngState.size();
+	header.nData = state.vAssign.size();
+	header.nDims = state.means.rows();
+	header.nClusters = state.means.cols();
+	header.nMetrics = state.covDiags.size();
+	header.nObjFuncs = state.objFuncs.size();
+	header.currIter = state.currIter;
+	if (state.visitOrder.size() != state.vAssign.size()) {
+		throw std::runtime_error("Can not checkpoint a state without its visit order\n");
+	}
+	for (size_t k = 0; k < state.covDiags.size(); ++k) {
+		if (state.rotations[k].size() > 0 && state.rotations[k].cols() != state.means.rows()) {
+			throw std::runtime_error("Can not checkpoint a rotation of another dimension\n");
+		}
+		header.nMetricValues += state.covDiags[k].size() + state.rotations[k].size();
+	}
+	CheckpointLayout layout(header);
+	header.fileSize = layout.fileSize;
+
+	std::vector<char> body(layout.fileSize - CHECKPOINT_HEADER_SIZE, 0);
+	auto put = [&](const size_t offset, const void* src, const size_t nBytes) {
+		if (nBytes > 0) std::memcpy(body.data() + offset - CHECKPOINT_HEADER_SIZE, src, nBytes);
+	};
+	put(layout.assign, state.vAssign.data(), header.nData * sizeof(int32_t));
+	put(layout.objFuncs, state.objFuncs.data(), header.nObjFuncs * sizeof(float));
+	put(layout.visitOrder, state.visitOrder.data(), header.nData * sizeof(int32_t));
+	put(layout.means, state.means.data(), state.means.size() * sizeof(float));
+	put(layout.logDets, state.logDets.data(), header.nMetrics * sizeof(float));
+	size_t metricOffset = layout.metrics;
+	for (size_t k = 0; k < header.nMetrics; ++k) {
+		uint32_t dims[2] = { (uint32_t) state.covDiags[k].size(), (uint32_t) state.rotations[k].rows() };
+		put(layout.metricDims + k * sizeof(dims), dims, sizeof(dims));
+		put(metricOffset, state.covDiags[k].data(), dims[0] * sizeof(float));
+		metricOffset += dims[0] * sizeof(float);
+		put(metricOffset, state.rotations[k].data(), state.rotations[k].size() * sizeof(float));
+		metricOffset += state.rotations[k].size() * sizeof(float);
+	}
+	put(layout.rngState, state.rngState.data(), header.nRngBytes);
+	header.checksum = checksumFNV1a(body.data(), body.size());
+
+	std::string tmpName = fileName + ".tmp";
+	std::ofstream ofs(tmpName.c_str(), std::ios::binary);
+	if (!ofs.is_open()) {
+		throw std::runtime_error("Can not open file to write: " + tmpName);
+	}
+	char headerBlock[CHECKPOINT_HEADER_SIZE] = {0};
+	std::memcpy(headerBlock, &header, sizeof(header));
+	ofs.write(headerBlock, CHECKPOINT_HEADER_SIZE);
+	ofs.write(body.data(), body.size());
+	ofs.close();
+	if (!ofs.good()) {
+		throw std::runtime_error("Error while writing file: " + tmpName);
+	}
+	if (0 != std::rename(tmpName.c_str(), fileName.c_str())) {
+		throw std::runtime_error("Can not rename checkpoint to: " + fileName);
+	}
+}
+
+/**
+ * Read-only view on a mmap-ed checkpoint, the maps are valid as long as
+ * this object lives
+ */
+class CheckpointFile {
+public:
+	typedef Eigen::Map<const Eigen::VectorXi> AssignMap;
+	typedef Eigen::Map<const Eigen::VectorXf> VectorMap;
+	typedef Eigen::Map<const Eigen::MatrixXf> MatrixMap;
+
+	explicit CheckpointFile(const std::string& fileName, bool verifyChecksum = true)
+		: file(fileName) {
+		if (file.size() < CHECKPOINT_HEADER_SIZE) {
+			throw std::runtime_error("Truncated checkpoint: " + fileName);
+		}
+		std::memcpy(&header, file.data(), sizeof(header));
+		if (0 != std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic))) {
+			throw std::runtime_error("Not a checkpoint: " + fileName);
+		}
+		if (header.version != CHECKPOINT_VERSION) {
+			throw std::runtime_error("Unsupported checkpoint version: " + fileName);
+		}
+		CheckpointLayout layout(header);
+		if (file.size() < layout.fileSize || header.fileSize != layout.fileSize) {
+			throw std::runtime_error("Truncated checkpoint: " + fileName);
+		}
+		if (verifyChecksum && header.checksum != checksumFNV1a(
+			file.data() + CHECKPOINT_HEADER_SIZE, layout.fileSize - CHECKPOINT_HEADER_SIZE)) {
+			throw std::runtime_error("Checksum mismatch in checkpoint: " + fileName);
+		}
+
+		const uint32_t* dims = reinterpret_cast<const uint32_t*>(file.data() + layout.metricDims);
+		size_t metricOffset = layout.metrics;
+		for (size_t k = 0; k < header.nMetrics; ++k) {
+			covOffsets.push_back(metricOffset);
+			covLengths.push_back(dims[2 * k]);
+			metricOffset += dims[2 * k] * sizeof(float);
+			rotOffsets.push_back(metricOffset);
+			rotRows.push_back(dims[2 * k + 1]);
+			metricOffset += (size_t) dims[2 * k + 1] * header.nDims * sizeof(float);
+		}
+		if (CheckpointLayout::align(metricOffset) != layout.rngState) {
+			throw std::runtime_error("Corrupted metrics in checkpoint: " + fileName);
+		}
+		assignOffset = layout.assign;
+		objFuncOffset = layout.objFuncs;
+		visitOrderOffset = layout.visitOrder;
+		meansOffset = layout.means;
+		logDetOffset = layout.logDets;
+		rngStateOffset = layout.rngState;
+	}
+
+	const CheckpointHeader& getHeader() const { return header; }
+	int numMetrics() const { return (int) header.nMetrics; }
+
+	AssignMap assignment() const { return AssignMap(as<int>(assignOffset), header.nData); }
+	VectorMap objFuncs() const { return VectorMap(as<float>(objFuncOffset), header.nObjFuncs); }
+	AssignMap visitOrder() const { return AssignMap(as<int>(visitOrderOffset), header.nData); }
+	MatrixMap means() const { return MatrixMap(as<float>(meansOffset), header.nDims, header.nClusters); }
+	float logDet(const int k) const { return as<float>(logDetOffset)[k]; }
+	VectorMap covDiag(const int k) const { return VectorMap(as<float>(covOffsets[k]), covLengths[k]); }
+	MatrixMap rotation(const int k) const {
+		return MatrixMap(as<float>(rotOffsets[k]), rotRows[k], 0 == rotRows[k] ? 0 : header.nDims);
+	}
+
+	// a copy, owned by the caller
+	ClusteringState toState() const {
+		ClusteringState state;
+		AssignMap assign = assignment();
+		state.vAssign.assign(assign.data(), assign.data() + assign.size());
+		state.means = means();
+		for (int k = 0; k < numMetrics(); ++k) {
+			state.covDiags.push_back(covDiag(k));
+			state.rotations.push_back(rotation(k));
+			state.logDets.push_back(logDet(k));
+		}
+		VectorMap costs = objFuncs();
+		state.objFuncs.assign(costs.data(), costs.data() + costs.size());
+		AssignMap order = visitOrder();
+		state.visitOrder.assign(order.data(), order.data() + order.size());
+		state.currIter = (int) header.currIter;
+		state.rngState.assign(as<char>(rngStateOffset), header.nRngBytes);
+		return state;
+	}
+
+private:
+	template <typename T>
+	const T* as(const size_t offset) const { return reinterpret_cast<const T*>(file.data() + offset); }
+
+	MappedFile file;
+	CheckpointHeader header;
+	size_t assignOffset = 0, objFuncOffset = 0, visitOrderOffset = 0, meansOffset = 0, logDetOffset = 0;
+	size_t rngStateOffset = 0;
+	std::vector<size_t> covOffsets, rotOffsets;
+	std::vector<int> covLengths, rotRows;
+};
+
+} /* namespace dml */
+
+#endif /* EMKMEANS_CHECKPOINT_H_ */
@@ -0,0 +1,44 @@
+/*
+ * ClusteringState.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * the solution of one run, used to seed the next run on the same data set
+ * (warm start): the assignment, the means and the learned metrics.
+ * A checkpoint also keeps the progress of the run (see Checkpoint.h).
+ */
+
+#ifndef EMKMEANS_CLUSTERINGSTATE_H_
+#define EMKMEANS_CLUSTERINGSTATE_H_
+
+#include <string>
+#include <vector>
+
+#include "../utils/Eigen3.h"
+
+namespace dml {
+
+class ClusteringState {
+public:
+    std::vector<int> vAssign;       // cluster of each data point
+    Eigen::MatrixXf means;          // one column per cluster
+
+    // one entry per distinct metric: one for the global metrics, one per
+    // cluster for the local ones (see MetricPolicy getParameters)
+    std::vector<Eigen::VectorXf> covDiags;
+    std::vector<Eigen::MatrixXf> rotations;    // full metrics only, empty otherwise
+    std::vector<float> logDets;
+
+    // progress of the run, ignored by the warm start
+    int currIter = 0;
+    std::vector<float> objFuncs;    // vObjFuncCached
+    std::vector<int> visitOrder;    // the shuffled order of the last E-step
+    std::string rngState;           // the random engine of the run (operator<< of std::mt19937)
+
+    bool empty() const { return vAssign.empty(); }
+};
+
+} /* namespace dml */
+
+#endif /* EMKMEANS_CLUSTERINGSTATE_H_ */
@@ -6,23 +6,30 @@
  */
 
 #include "EMKMeans.h"
+#include "Checkpoint.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <limits>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 
 #include "../utils/functionUtils.h"
+#include "../utils/parallelUtils.h"
 #include "../gaussian/SimpleGaussian.cpp"
 #include "../gaussian/DiagGaussian.cpp"
 #include "../gaussian/FullGaussian.cpp"
+#include "../gaussian/LowRankGaussian.cpp"
 
 namespace dml {
 
 using namespace Eigen;
 
-EMKMeans::EMKMeans(const Ref<const MatrixXf>& dataset, const int numClts, const CovType type) {
-	data = dataset;
+template <typename Storage, typename Acc>
+EMKMeans<Storage, Acc>::EMKMeans(const ConstDataRef& dataset, const int numClts, const CovType type)
+	: data(dataset), rng() {
 	nDims = data.rows();
 	nData = data.cols();
 	nClusters = numClts;
@@ -34,22 +41,34 @@ EMKMeans::EMKMeans(const Ref<const MatrixXf>& dataset, const int numClts, const
 	createMixtures();
 }
 
-void EMKMeans::createMixtures() {
+template <typename Storage, typename Acc>
+EMKMeans<Storage, Acc>::~EMKMeans() {
+	if (pendingCheckpoint.valid()) {
+		pendingCheckpoint.wait();
+	}
+}
+
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::createMixtures() {
 	vMixture.reserve(nClusters);
 	int nEstimateSize = nData / nClusters;
 	for (int clusterId = 0; clusterId < nClusters; ++clusterId) {
 		switch (covType) {
 			case COV_NONE:
 				vMixture.push_back( GaussianPtr(
-					new SimpleGaussian(clusterId, nEstimateSize, nDims) ) );
+					new SimpleGaussian<Storage, Acc>(clusterId, nEstimateSize, nDims) ) );
 			break;
 			case COV_DIAG:
 				vMixture.push_back( GaussianPtr(
-					new DiagGaussian(clusterId, nEstimateSize, nDims) ) );
+					new DiagGaussian<Storage, Acc>(clusterId, nEstimateSize, nDims) ) );
 			break;
 			case COV_FULL:
 			vMixture.push_back( GaussianPtr(
-					new FullGaussian(clusterId, nEstimateSize, nDims) ) );
+					new FullGaussian<Storage, Acc>(clusterId, nEstimateSize, nDims) ) );
+			break;
+			case COV_LOWRANK:
+				vMixture.push_back( GaussianPtr(
+					new LowRankGaussian<Storage, Acc>(clusterId, nEstimateSize, nDims) ) );
 			break;
 			default:
 				assert(false && "Invalid covariance type!");
@@ -58,23 +77,83 @@ void EMKMeans::createMixtures() {
 	}
 }
 
-float EMKMeans::getCurrentCost() {
+template <typename Storage, typename Acc>
+float EMKMeans<Storage, Acc>::getCurrentCost() {
 	return ((0 == vObjFuncCached.size()) ? 0.0f : vObjFuncCached.back());
 }
 
-std::vector<int> EMKMeans::doClustering(const int maxIteration, const float minObjFuncChange) {
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::setNumThreads(const int numThreads) {
+	nThreads = resolveNumThreads(numThreads);
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void EMKMeans<Storage, Acc>::setDiameterMethod(const DiameterMethod method) {
+	for (GaussianPtr& gaussian : vMixture) {
+		gaussian->setDiameterMethod(method);
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void EMKMeans<Storage, Acc>::setConstraintModel(const ConstraintModel model) {
+	constraintModel = model;
+	for (GaussianPtr& gaussian : vMixture) {
+		gaussian->setConstraintModel(model);
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void EMKMeans<Storage, Acc>::setLogger(const LogFunc& log) {
+	logger = log;
+	for (GaussianPtr& gaussian : vMixture) {
+		gaussian->setLogger(log);
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void EMKMeans<Storage, Acc>::setMetricRank(const int rank) {
+	for (GaussianPtr& gaussian : vMixture) {
+		gaussian->setMetricRank(rank);
+	}
+}
+
+template <typename Storage, typename Acc>
+std::vector<int> EMKMeans<Storage, Acc>::doClustering(const int maxIteration, const float minObjFuncChange) {
 	maxIter = maxIteration;
 	minChange = minObjFuncChange;
 	//std::cout << "Do clustering with: nClusters=" << nClusters
 			//<< ", maxIter=" << maxIter << ", minChange=" << minChange
 			//<< ", nData=" << nData << ", nDims=" << nDims << '\n';
-	createInitCenters();
-	doVeryFirstClustering();
-	runEM();
+	if (!resumeFile.empty()) {
+		if (miniBatchSize > 0) {
+			throw std::runtime_error("Can not resume a mini-batch run, checkpoints are full batch only\n");
+		}
+		resumeFromCheckpoint();
+		// the criterion of checkConvergence on the last two costs of the checkpoint
+		size_t nCosts = vObjFuncCached.size();
+		bool converged = (currIter >= maxIter) || (nCosts >= 2
+			&& vObjFuncCached[nCosts - 2] - vObjFuncCached[nCosts - 1] <= minChange);
+		if (!converged) {
+			runEM();
+		}
+		return vAssign;
+	}
+	if (warmState.empty()) {
+		createInitCenters();
+	} else {
+		applyWarmStart(warmState);
+	}
+	if (miniBatchSize > 0) {
+		runMiniBatchEM();
+	} else {
+		doVeryFirstClustering();
+		runEM();
+	}
 	return vAssign;
 }
 
-EMResult EMKMeans::getResult() {
+template <typename Storage, typename Acc>
+EMResult EMKMeans<Storage, Acc>::getResult() {
     EMResult result;
     result.iterTerminate = currIter;
     result.cost = vObjFuncCached.back();
@@ -83,29 +162,114 @@ EMResult EMKMeans::getResult() {
     return result;
 }
 
-void EMKMeans::createInitCenters() {
+template <typename Storage, typename Acc>
+ClusteringState EMKMeans<Storage, Acc>::getState() {
+	ClusteringState state;
+	state.vAssign = vAssign;
+	state.means.resize(nDims, nClusters);
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		state.means.col(cltId) = vMixture.at(cltId)->getMean().template cast<float>();
+	}
+	saveMetrics(state);
+	state.currIter = currIter;
+	state.objFuncs = vObjFuncCached;
+	state.visitOrder = vVisitOrder;
+	return state;
+}
+
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::applyWarmStart(const ClusteringState& state) {
+	if ((int) state.vAssign.size() != nData
+		|| state.means.rows() != nDims || state.means.cols() != nClusters) {
+		throw std::runtime_error("The warm start state does not match the data set\n");
+	}
+	vAssign = state.vAssign;
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		vMixture.at(cltId)->setInitCenter(state.means.col(cltId));
+	}
+	restoreMetrics(state);
+}
+
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::setCheckpoint(const std::string& fileName, const int nIterations) {
+	checkpointFile = fileName;
+	checkpointEvery = nIterations;
+}
+
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::saveCheckpoint() {
+	ClusteringState state = getState();
+	// the resumed run continues the sequence of this one
+	std::ostringstream engineState;
+	engineState << rng;
+	state.rngState = engineState.str();
+
+	waitCheckpoint();
+	std::string fileName = checkpointFile;
+	pendingCheckpoint = std::async(std::launch::async,
+		[fileName, state = std::move(state)]() { writeCheckpoint(fileName, state); });
+}
+
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::waitCheckpoint() {
+	if (pendingCheckpoint.valid()) {
+		pendingCheckpoint.get();
+	}
+}
+
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::resumeFromCheckpoint() {
+	ClusteringState state;
+	{
+		CheckpointFile file(resumeFile);
+		state = file.toState();
+	}
+	applyWarmStart(state);
+	currIter = state.currIter;
+	vObjFuncCached = state.objFuncs;
+	vVisitOrder = state.visitOrder;
+	if (!state.rngState.empty()) {
+		std::istringstream engineState(state.rngState);
+		engineState >> rng;
+	}
+	// the statistics of the last E-step, read by the online update
+	accumulateStatistics();
+	resumeCaches();
+}
+
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::createInitCenters() {
 	int nEstimate = nData / nClusters;
 	for (int cltId = 0; cltId < nClusters; ++cltId) {
-		int rndIdx = cltId * nEstimate + randomInRange(0, nEstimate);
-		vMixture.at(cltId)->setInitCenter(data.col(rndIdx));
+		int rndIdx = cltId * nEstimate + randomInRange(0, nEstimate, rng);
+		vMixture.at(cltId)->setInitCenter(data.col(rndIdx).template cast<float>());
 	}
 }
 
-/*virtual*/ void EMKMeans::doVeryFirstClustering() {}
+template <typename Storage, typename Acc>
+/*virtual*/ void EMKMeans<Storage, Acc>::doVeryFirstClustering() {}
 
-void EMKMeans::runEM()
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::runEM()
 {
-	std::vector<int> randomIndex(nData);
-	for (int i = 0; i < nData; ++i) {
-		randomIndex.at(i) = i;
+	// a resumed run goes on from the order of the checkpoint
+	if ((int) vVisitOrder.size() != nData) {
+		vVisitOrder.resize(nData);
+		for (int i = 0; i < nData; ++i) {
+			vVisitOrder.at(i) = i;
+		}
 	}
 
 	// start with a big value of objFunc, so the next iteration with be decreased
-	vObjFuncCached.push_back(std::numeric_limits<float>::max());
+	// (a resumed run has the values of the checkpoint)
+	if (vObjFuncCached.empty()) {
+		vObjFuncCached.push_back(std::numeric_limits<float>::max());
+	}
 	float currentCost = 0.0f;
+	bool converged = false;
 	do {
-		shuffleVector(randomIndex);
-		runEStep(randomIndex);
+		shuffleVector(vVisitOrder, rng);
+		runEStep(vVisitOrder);
 		runMStep();
 		currIter++;
 		currentCost = calculateObjFunc();
@@ -113,42 +277,81 @@ void EMKMeans::runEM()
 		// 		<< "\tcost = " << currentCost
 		// 		<< "\tchange = " << vObjFuncCached.back() - currentCost
 		// 		<< "\tdebugVMeasure = " << VMeasure(vAssign, nClusters, nClusters) << "\n\n";
-	} while (false == checkConvergence(currentCost));
+		converged = checkConvergence(currentCost);
+		if (checkpointEvery > 0 && (converged || 0 == currIter % checkpointEvery)) {
+			saveCheckpoint();
+		}
+	} while (false == converged);
+	waitCheckpoint();
 }
 
-void EMKMeans::runEStep(const std::vector<int>& randomIndex) {
-	findBestCluster(randomIndex);
-	adaptMixturesSize();
-	assignData();
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::runMiniBatchEM()
+{
+	const int MINI_BATCH_PATIENCE = 10;
+	// weight of one batch in the moving average, about 2 / (batches per epoch)
+	const float smoothing = std::min(1.0f, 2.0f * miniBatchSize / (nData + 1));
+
+	std::vector<int> batch;
+	vObjFuncCached.push_back(std::numeric_limits<float>::max());
+	float movingCost = 0.0f;
+	float bestCost = std::numeric_limits<float>::max();
+	int nNoImprovement = 0;
+	startMiniBatch();
+	do {
+		sampleBatch(batch);
+		float batchCost = miniBatchStep(batch) * nData / batch.size();
+		movingCost = (0 == currIter) ? batchCost : (1.0f - smoothing) * movingCost + smoothing * batchCost;
+		currIter++;
+		vObjFuncCached.push_back(movingCost);
+
+		if (movingCost < bestCost - minChange) {
+			bestCost = movingCost;
+			nNoImprovement = 0;
+		} else {
+			nNoImprovement++;
+		}
+	} while (currIter < maxIter && nNoImprovement < MINI_BATCH_PATIENCE);
+	finishMiniBatch();
 }
 
-void EMKMeans::adaptMixturesSize()
-{
-	std::vector<int> vCount(nClusters);
-	vCount.assign(nClusters, 0);
-	for (int i = 0; i < nData; ++i) {
-		++vCount.at(vAssign.at(i));
+template <typename Storage, typename Acc>
+/*virtual*/ void EMKMeans<Storage, Acc>::sampleBatch(std::vector<int>& batch) {
+	// with replacement, the duplicates are dropped
+	batch.resize(std::min(miniBatchSize, nData));
+	for (int& idx : batch) {
+		idx = randomInRange(0, nData, rng);
 	}
-	// dump("vCount", vCount);
+	std::sort(batch.begin(), batch.end());
+	batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+	shuffleVector(batch, rng);
+}
 
-	for (int cltId = 0; cltId < nClusters; ++cltId) {
-		vMixture.at(cltId)->adaptNewSize(vCount[cltId]);
-	}
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::runEStep(const std::vector<int>& randomIndex) {
+	findBestCluster(randomIndex);
+	accumulateStatistics();
 }
 
-void EMKMeans::assignData()
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::accumulateStatistics()
 {
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		vMixture.at(cltId)->resetStatistics();
+	}
 	for (int i = 0; i < nData; ++i) {
-		vMixture.at(vAssign.at(i))->insertDataPoint(data.col(i));
+		vMixture[vAssign[i]]->addPoint(data, i);
 	}
 }
 
-void EMKMeans::runMStep()
+template <typename Storage, typename Acc>
+void EMKMeans<Storage, Acc>::runMStep()
 {
 	updateMixtures();
 }
 
-bool EMKMeans::checkConvergence(const float currentCost) {
+template <typename Storage, typename Acc>
+bool EMKMeans<Storage, Acc>::checkConvergence(const float currentCost) {
 	float prevCost = vObjFuncCached.back();
 	vObjFuncCached.push_back(currentCost);
 	bool convergenceWhenExceedMaxIterations = (currIter >= maxIter);
@@ -156,4 +359,8 @@ bool EMKMeans::checkConvergence(const float currentCost) {
 	return (convergenceWhenExceedMaxIterations || convergenceWhenNoChange);
 }
 
+template class EMKMeans<float, float>;
+template class EMKMeans<float, double>;
+template class EMKMeans<Eigen::half, float>;
+
 } /* namespace dml */
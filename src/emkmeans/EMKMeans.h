@@ -10,42 +10,135 @@
 #ifndef EMKMEANS_EMKMEANS_H_
 #define EMKMEANS_EMKMEANS_H_
 
+#include <future>
 #include <memory>
+#include <random>
+#include <string>
 #include <vector>
 
+#include "ClusteringState.h"
 #include "EMResult.h"
 #include "../gaussian/Gaussian.h"
 #include "../utils/Eigen3.h"
 
 namespace dml {
 
-enum CovType {
-	COV_NONE, COV_DIAG, COV_FULL
-};
-
-typedef std::shared_ptr<Gaussian> GaussianPtr;
-
+/**
+ * Storage: scalar of the stored data set (Eigen::half, float)
+ * Acc: scalar of the accumulations in the gaussians (float, double)
+ * instantiated for <float, float>, <float, double> and <Eigen::half, float>
+ */
+template <typename Storage = float, typename Acc = float>
 class EMKMeans {
 public:
-	EMKMeans(const Eigen::Ref<const Eigen::MatrixXf>& dataset,
+	typedef Gaussian<Storage, Acc> GaussianType;
+	typedef std::shared_ptr<GaussianType> GaussianPtr;
+	typedef typename GaussianType::DataMatrix DataMatrix;
+	typedef typename GaussianType::ConstDataRef ConstDataRef;
+
+	// the data set is not copied, it must outlive the algorithm
+	EMKMeans(const ConstDataRef& dataset,
 		const int numClts, const CovType type = COV_NONE);
-	virtual ~EMKMeans() {}
+	virtual ~EMKMeans();
 
 	std::vector<int> doClustering(const int maxIteration = 100, const float minObjFuncChange = 0.01f);
 	virtual EMResult getResult();
     float getCurrentCost();
 
+	// threads used inside one run (E-step), 0 = one per core, default 1
+	void setNumThreads(const int numThreads);
+
+	// seed of the random engine of this run (initial centers, visit order,
+	// batches), default: the fixed default seed of std::mt19937, so that a
+	// run never reads the process wide std::rand
+	void setSeed(const unsigned seed) { rng.seed(seed); }
+
+	// MacQueen style E-step: a point that changes cluster moves the means of
+	// both clusters, and their local diagonal metrics, at once (sequential
+	// E-step only, ignored with a message on several threads), default false
+	void setOnlineUpdate(const bool online) { onlineUpdate = online; }
+
+	// estimator of the diameter used by the cannot-link penalty, default exact
+	virtual void setDiameterMethod(const DiameterMethod method);
+
+	// skip the clusters that can not win by bounds on the point-to-mean
+	// distances (global metric, sequential E-step only), default false
+	void setBoundPruning(const bool pruning) { boundPruning = pruning; }
+
+	// search the candidate clusters in a k-d tree over the means instead of
+	// scanning all K (global metric, sequential E-step only), default false
+	void setCenterIndex(const bool useIndex) { centerIndex = useIndex; }
+
+	// constraints as expanded pairs (default) or as components, see ConstraintModel
+	virtual void setConstraintModel(const ConstraintModel model);
+
+	// eigenpairs kept by the low-rank metrics (LowRankMetric), default 32
+	virtual void setMetricRank(const int rank);
+
+	// progress messages of the run and of its gaussians, empty = silent (default)
+	virtual void setLogger(const LogFunc& log);
+
+	/**
+	 * warm start: the next doClustering starts from the state of a previous
+	 * run on the same data set (its assignment, means and metrics) instead of
+	 * createInitCenters and the default metric
+	 */
+	void setWarmStart(const ClusteringState& state) { warmState = state; }
+	// the solution of the last doClustering, to seed the next run
+	ClusteringState getState();
+
+	// mini-batch EM: each iteration assigns batchSize random points (and their
+	// constraint neighbours) and moves the means and the metric statistics
+	// toward them, one iteration is one batch, 0 = full batch (default)
+	void setMiniBatchSize(const int batchSize) { miniBatchSize = batchSize; }
+
+	/**
+	 * checkpoint: every nIterations of the full batch EM, and at its end, the
+	 * state (see getState) is written into fileName by a background thread,
+	 * 0 = no checkpoint (default). Full batch only: the mini-batch EM
+	 * (setMiniBatchSize) never writes one
+	 */
+	void setCheckpoint(const std::string& fileName, const int nIterations);
+	// the next doClustering resumes the run checkpointed in fileName (full
+	// batch only), a run checkpointed at its convergence returns at once
+	void setResume(const std::string& fileName) { resumeFile = fileName; }
+
 protected:
 
 	void createMixtures();
 	void runEM();
 	void runEStep(const std::vector<int>& randomIndex);
-	void adaptMixturesSize();
-	void assignData();
+	void accumulateStatistics();
 	void runMStep();
 	bool checkConvergence(const float currentCost);
 
+	/**
+	 * stops when the moving average of the batch costs (scaled to the data
+	 * set) did not decrease by minChange during MINI_BATCH_PATIENCE batches
+	 */
+	void runMiniBatchEM();
+	// the caches the batches need (the ones of doVeryFirstClustering)
+	virtual void startMiniBatch() = 0;
+	virtual void sampleBatch(std::vector<int>& batch);
+	// assign the points of the batch and step the gaussians, the cost of the batch
+	virtual float miniBatchStep(const std::vector<int>& batch) = 0;
+	// the assignment of all points with the final means, and its cost
+	virtual void finishMiniBatch() = 0;
+
 	virtual void createInitCenters();
+	// vAssign, means and metrics from state
+	void applyWarmStart(const ClusteringState& state);
+	// snapshot of the state, written by a background thread
+	void saveCheckpoint();
+	// rethrows the error of the last write
+	void waitCheckpoint();
+	// the state and the progress of the checkpoint, in place of createInitCenters
+	// and doVeryFirstClustering
+	void resumeFromCheckpoint();
+	// the caches the E-step reads, from the restored means and metrics
+	virtual void resumeCaches() {}
+	virtual void saveMetrics(ClusteringState& state) {}
+	virtual void restoreMetrics(const ClusteringState& state) {}
 	virtual void doVeryFirstClustering();
 	virtual void findBestCluster(const std::vector<int>& randomIndex) = 0;
 	virtual void updateMixtures() = 0;
@@ -57,18 +150,37 @@ protected:
 	int nDims = 0;				// number of dimension (features) of each data point
 	int nClusters = 0;			// the number of cluster
 
-	Eigen::MatrixXf data; 		// one column is one data point
+	ConstDataRef data; 			// one column is one data point, owned by the caller
 	std::vector<int> vAssign;	// the assignment of each data point to its cluster
 	                            // vAssigment[data_point_id] => cluster_id
 	std::vector<GaussianPtr> vMixture;	// the mixture of Gaussians
 	std::vector<float> vObjFuncCached;	// all value of obj function at each iteration
-
+	std::vector<int> vVisitOrder;		// order of the points in the E-step, shuffled
+	                                    // again at each iteration
+	std::mt19937 rng;			// random engine of the run, saved by the checkpoint
+	LogFunc logger;				// empty = silent
+
+	int nThreads = 1;			// threads used inside one run
+	bool onlineUpdate = false;	// update the means during the E-step
+	ConstraintModel constraintModel = CONSTRAINT_PAIRS;
+	bool boundPruning = false;	// Hamerly bounds in the E-step
+	bool centerIndex = false;	// k-d tree over the means in the E-step
+	int miniBatchSize = 0;		// points sampled per iteration, 0 = full batch
+	ClusteringState warmState;	// empty = cold start
+	std::string checkpointFile;
+	int checkpointEvery = 0;	// iterations between checkpoints, 0 = none
+	std::future<void> pendingCheckpoint;	// the write in flight
+	std::string resumeFile;		// empty = start a new run
 	int maxIter = 0; 			// maximum iterator, if exceed the maxIter, then convergence!
 	int currIter = 0; 			// current iterator
 	float minChange = 0.0f;		// the minimun change of objetive function
 	                            // if the change between 2 iterator is smaller than the minChange, then convergence!
 };
 
+extern template class EMKMeans<float, float>;
+extern template class EMKMeans<float, double>;
+extern template class EMKMeans<Eigen::half, float>;
+
 } /* namespace dml */
 
 #endif /* EMKMEANS_EMKMEANS_H_ */
@@ -34,6 +34,8 @@ public:
     float clConst = 0.0f;              // cannotlink coeff constant used
     float vMeasure = 0.0f;             // measure performance with ground truth
     float duration = 0.0f;             // running time in millisecond
+    double nDistEvaluated = 0.0;       // point-to-mean distances evaluated
+    double nDistSkipped = 0.0;         // point-to-mean distances skipped by the bounds
 
     void add(const EMResult& r) {
         this->iterTerminate +=      r.iterTerminate;
@@ -47,6 +49,8 @@ public:
         this->nCLViolation +=       r.nCLViolation;
         this->vMeasure +=           r.vMeasure;
         this->duration +=           r.duration;
+        this->nDistEvaluated +=     r.nDistEvaluated;
+        this->nDistSkipped +=       r.nDistSkipped;
     }
 
     void divise(const float factor) {
@@ -61,6 +65,8 @@ public:
         this->nCLViolation          /= factor;
         this->vMeasure              /= factor;
         this->duration              /= factor;
+        this->nDistEvaluated        /= factor;
+        this->nDistSkipped          /= factor;
     }
 
     std::string toJson() const {
@@ -77,6 +83,8 @@ public:
         json += ("\t\"nCLViolation\":\t" +        std::to_string(nCLViolation)         + ",\n");
         json += ("\t\"vMeasure\":\t" +            std::to_string(vMeasure)             + ",\n");
         json += ("\t\"duration\":\t" +            std::to_string(duration)             + ",\n");
+        json += ("\t\"nDistEvaluated\":\t" +      std::to_string(nDistEvaluated)       + ",\n");
+        json += ("\t\"nDistSkipped\":\t" +        std::to_string(nDistSkipped)         + ",\n");
         json += ("\t\"mlConst\":\t" +             std::to_string(mlConst)              + ",\n");
         json += ("\t\"clConst\":\t" +             std::to_string(clConst)              + "\n");
         json += "}";
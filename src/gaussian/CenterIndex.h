@@ -0,0 +1,155 @@
+/*
+ * CenterIndex.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * k-d tree over the means in a whitened space (where the metric is the
+ * Euclidean one): nearest mean and the means within a radius of a point
+ * without scanning all K. The tree splits on the coordinate of largest spread,
+ * so a metric that concentrates the mass on a few directions (or a projection
+ * on a few components) is cut along them. Built in O(K log K) after each
+ * M-step; in high dimension the search degrades to a scan of the leaves.
+ */
+
+#ifndef GAUSSIAN_CENTERINDEX_H_
+#define GAUSSIAN_CENTERINDEX_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "../utils/Eigen3.h"
+
+namespace dml {
+
+class CenterIndex {
+public:
+	typedef Eigen::Ref<const Eigen::VectorXf> ConstPointRef;
+
+	/**
+	 * @param centers whitened means, one column is one mean (d x K)
+	 */
+	void build(const Eigen::Ref<const Eigen::MatrixXf>& centers) {
+		int nCenters = centers.cols();
+		order.resize(nCenters);
+		for (int k = 0; k < nCenters; ++k) order[k] = k;
+		nodes.clear();
+		if (nCenters > 0) buildNode(centers, 0, nCenters);
+		sorted.resize(centers.rows(), nCenters);
+		for (int j = 0; j < nCenters; ++j) sorted.col(j) = centers.col(order[j]);
+	}
+
+	int numCenters() const { return (int) order.size(); }
+
+	/**
+	 * the nearest mean (-1 when empty), its distance in dist, the distances
+	 * evaluated are added to nEvaluated
+	 */
+	int nearest(const ConstPointRef& x, float& dist, int& nEvaluated) const {
+		int best = -1;
+		float best2 = std::numeric_limits<float>::max();
+		if (!nodes.empty()) searchNearest(0, x, best, best2, nEvaluated);
+		dist = (best < 0) ? best2 : std::sqrt(best2);
+		return best;
+	}
+
+	/**
+	 * the means at distance <= radius of x, as (cltId, distance)
+	 */
+	void withinRadius(const ConstPointRef& x, const float radius,
+		std::vector<std::pair<int, float> >& found, int& nEvaluated) const {
+		found.clear();
+		if (nodes.empty() || radius < 0.0f) return;
+		searchRadius(0, x, radius * radius, found, nEvaluated);
+	}
+
+private:
+	static const int LEAF_SIZE = 8;
+
+	// a leaf when left < 0; [first, last) are positions in order / sorted
+	struct Node {
+		int first;
+		int last;
+		int splitDim;
+		float splitValue;
+		int left;
+		int right;
+	};
+
+	int buildNode(const Eigen::Ref<const Eigen::MatrixXf>& centers, const int first, const int last) {
+		int nodeId = (int) nodes.size();
+		nodes.push_back(Node{first, last, 0, 0.0f, -1, -1});
+		if (last - first <= LEAF_SIZE) return nodeId;
+
+		Eigen::VectorXf lo = centers.col(order[first]), hi = lo;
+		for (int j = first + 1; j < last; ++j) {
+			lo = lo.cwiseMin(centers.col(order[j]));
+			hi = hi.cwiseMax(centers.col(order[j]));
+		}
+		int splitDim = 0;
+		if ((hi - lo).maxCoeff(&splitDim) <= 0.0f) return nodeId;	// all equal
+
+		int middle = first + (last - first) / 2;
+		std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + last,
+			[&](int a, int b) { return centers(splitDim, a) < centers(splitDim, b); });
+		float splitValue = centers(splitDim, order[middle]);
+
+		int left = buildNode(centers, first, middle);
+		int right = buildNode(centers, middle, last);
+		Node& node = nodes[nodeId];
+		node.splitDim = splitDim;
+		node.splitValue = splitValue;
+		node.left = left;
+		node.right = right;
+		return nodeId;
+	}
+
+	void searchNearest(const int nodeId, const ConstPointRef& x,
+		int& best, float& best2, int& nEvaluated) const {
+		const Node& node = nodes[nodeId];
+		if (node.left < 0) {
+			for (int j = node.first; j < node.last; ++j) {
+				float d2 = (sorted.col(j) - x).squaredNorm();
+				// the smallest id on a tie, as the scan over the clusters
+				if (d2 < best2 || (d2 == best2 && order[j] < best)) {
+					best2 = d2;
+					best = order[j];
+				}
+			}
+			nEvaluated += node.last - node.first;
+			return;
+		}
+		float gap = x[node.splitDim] - node.splitValue;
+		int nearSide = (gap < 0.0f) ? node.left : node.right;
+		int farSide = (gap < 0.0f) ? node.right : node.left;
+		searchNearest(nearSide, x, best, best2, nEvaluated);
+		if (gap * gap <= best2) searchNearest(farSide, x, best, best2, nEvaluated);
+	}
+
+	void searchRadius(const int nodeId, const ConstPointRef& x, const float radius2,
+		std::vector<std::pair<int, float> >& found, int& nEvaluated) const {
+		const Node& node = nodes[nodeId];
+		if (node.left < 0) {
+			for (int j = node.first; j < node.last; ++j) {
+				float d2 = (sorted.col(j) - x).squaredNorm();
+				if (d2 <= radius2) found.push_back(std::make_pair(order[j], std::sqrt(d2)));
+			}
+			nEvaluated += node.last - node.first;
+			return;
+		}
+		float gap = x[node.splitDim] - node.splitValue;
+		if (gap < 0.0f || gap * gap <= radius2) searchRadius(node.left, x, radius2, found, nEvaluated);
+		if (gap >= 0.0f || gap * gap <= radius2) searchRadius(node.right, x, radius2, found, nEvaluated);
+	}
+
+	std::vector<int> order;		// position in the tree -> cltId
+	std::vector<Node> nodes;	// nodes[0] is the root
+	Eigen::MatrixXf sorted;		// the means in tree order
+};
+
+} /* namespace dml */
+
+#endif /* GAUSSIAN_CENTERINDEX_H_ */
@@ -0,0 +1,170 @@
+/*
+ * ComponentMoments.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * The ML / CL impact on the metrics evaluated per group instead of per pair.
+ * The members of each constraint component are split by cluster and each part
+ * keeps its count n, mean m and centered scatter M (sum of (x - m)(x - m)').
+ * For two disjoint sets P and R (pairwise-variance formula):
+ *   sum_{i in P, j in R} (xi - xj)(xi - xj)' = nR MP + nP MR + nP nR (mP - mR)(mP - mR)'
+ * The diagonal metrics keep the diagonal only (M = sum of (x - m).^2).
+ */
+
+#ifndef GAUSSIAN_COMPONENTMOMENTS_H_
+#define GAUSSIAN_COMPONENTMOMENTS_H_
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "../utils/Eigen3.h"
+#include "../constraint/ConstraintComponents.h"
+
+namespace dml {
+
+/**
+ * Moment: Eigen::VectorX<Acc> (diagonal) or Eigen::MatrixX<Acc> (full)
+ */
+template <typename Acc, typename Moment>
+struct PointMoments {
+	int cltId = 0;
+	Acc count = 0;
+	Eigen::VectorX<Acc> mean;
+	Moment scatter;		// empty when no impact reads the part
+
+	static void zeroMoment(Eigen::VectorX<Acc>& q, const int dimensions) {
+		q = Eigen::VectorX<Acc>::Zero(dimensions);
+	}
+	static void zeroMoment(Eigen::MatrixX<Acc>& q, const int dimensions) {
+		q = Eigen::MatrixX<Acc>::Zero(dimensions, dimensions);
+	}
+	// q += weight * x x' (diagonal: weight * x.^2)
+	static void addOuter(Eigen::VectorX<Acc>& q, const Eigen::VectorX<Acc>& x, const Acc weight) {
+		q += weight * x.cwiseAbs2();
+	}
+	static void addOuter(Eigen::MatrixX<Acc>& q, const Eigen::VectorX<Acc>& x, const Acc weight) {
+		q.noalias() += weight * x * x.transpose();
+	}
+};
+
+template <typename Acc, typename Moment>
+using ComponentParts = std::vector<std::vector<PointMoments<Acc, Moment> > >;
+
+// sum_{i in P, j in R} (xi - xj)(xi - xj)' (diagonal: (xi - xj).^2)
+template <typename Acc, typename Moment>
+void addCrossScatter(const PointMoments<Acc, Moment>& P, const PointMoments<Acc, Moment>& R,
+	const Acc weight, Moment& impact) {
+	impact += (weight * R.count) * P.scatter;
+	impact += (weight * P.count) * R.scatter;
+	PointMoments<Acc, Moment>::addOuter(impact, P.mean - R.mean, weight * P.count * R.count);
+}
+
+/**
+ * parts[comp]: count, mean and centered scatter of the members of comp in
+ * each cluster they occupy, sorted by cluster. Computed once per M-step and
+ * shared by the gaussians; the scatter is only formed for the parts an impact
+ * reads: those of a component split over clusters (ML) and those sharing
+ * their cluster with a part of a cannot-linked component (CL).
+ */
+template <typename Acc, typename Moment, typename Derived>
+void componentMoments(const Eigen::MatrixBase<Derived>& X, const std::vector<int>& vAssign,
+	const ConstraintComponents& components, ComponentParts<Acc, Moment>& parts) {
+
+	typedef PointMoments<Acc, Moment> Part;
+	int nDims = X.rows();
+	int nComps = components.numComponents();
+	parts.assign(nComps, std::vector<Part>());
+	std::vector<std::vector<std::pair<int, int> > > byCluster(nComps);	// (cltId, idx)
+
+	// counts and running means
+	for (int comp = 0; comp < nComps; ++comp) {
+		for (const int& idx : components.members(comp)) {
+			byCluster[comp].push_back(std::make_pair(vAssign[idx], idx));
+		}
+		std::sort(byCluster[comp].begin(), byCluster[comp].end());
+		for (const auto& member : byCluster[comp]) {
+			if (parts[comp].empty() || parts[comp].back().cltId != member.first) {
+				parts[comp].push_back(Part());
+				parts[comp].back().cltId = member.first;
+				parts[comp].back().mean = Eigen::VectorX<Acc>::Zero(nDims);
+			}
+			Part& part = parts[comp].back();
+			part.count += 1;
+			part.mean += (X.col(member.second).template cast<Acc>() - part.mean) / part.count;
+		}
+	}
+
+	auto sharesCluster = [&](const std::vector<Part>& other, const int cltId) {
+		auto it = std::lower_bound(other.begin(), other.end(), cltId,
+			[](const Part& part, const int id) { return part.cltId < id; });
+		return (it != other.end()) && (it->cltId == cltId);
+	};
+
+	// centered scatter of the parts read by an impact
+	for (int comp = 0; comp < nComps; ++comp) {
+		auto member = byCluster[comp].begin();
+		for (Part& part : parts[comp]) {
+			bool needed = (parts[comp].size() > 1);
+			for (const int& comp2 : components.cannotLinked(comp)) {
+				if (needed) break;
+				needed = sharesCluster(parts[comp2], part.cltId);
+			}
+			auto last = member + (int) part.count;
+			if (needed) {
+				Part::zeroMoment(part.scatter, nDims);
+				for (; member != last; ++member) {
+					Part::addOuter(part.scatter,
+						X.col(member->second).template cast<Acc>() - part.mean, Acc(1));
+				}
+			}
+			member = last;
+		}
+	}
+}
+
+/**
+ * ML of one component violated from the side of cltId (every cluster when
+ * allClusters), added to impact: sum over its members i in the cluster and j
+ * outside of it. nViolations counts the ordered pairs, as the pairwise loops do.
+ */
+template <typename Acc, typename Moment>
+void addMustLinkScatter(const std::vector<PointMoments<Acc, Moment> >& parts,
+	const int cltId, const bool allClusters, Moment& impact, int& nViolations) {
+	if (parts.size() < 2) return;
+	for (const auto& part : parts) {
+		if (!allClusters && part.cltId != cltId) continue;
+		for (const auto& other : parts) {
+			if (&other == &part) continue;
+			addCrossScatter(part, other, Acc(1), impact);
+			nViolations += (int) (part.count * other.count);
+		}
+	}
+}
+
+/**
+ * CL between the components of partsA and partsB whose members share the
+ * cluster cltId (every cluster when allClusters), in both directions,
+ * subtracted from impact
+ */
+template <typename Acc, typename Moment>
+void subtractCannotLinkScatter(const std::vector<PointMoments<Acc, Moment> >& partsA,
+	const std::vector<PointMoments<Acc, Moment> >& partsB,
+	const int cltId, const bool allClusters, Moment& impact, int& nViolations) {
+	auto itA = partsA.begin(), itB = partsB.begin();
+	while (itA != partsA.end() && itB != partsB.end()) {
+		if (itA->cltId < itB->cltId) { ++itA; continue; }
+		if (itB->cltId < itA->cltId) { ++itB; continue; }
+		if (allClusters || itA->cltId == cltId) {
+			addCrossScatter(*itA, *itB, Acc(-2), impact);
+			nViolations += (int) (2 * itA->count * itB->count);
+		}
+		++itA;
+		++itB;
+	}
+}
+
+} /* namespace dml */
+
+#endif /* GAUSSIAN_COMPONENTMOMENTS_H_ */
@@ -0,0 +1,236 @@
+/*
+ * CovarianceGaussian.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ */
+
+#ifndef GAUSSIAN_COVARIANCEGAUSSIAN_H_
+#define GAUSSIAN_COVARIANCEGAUSSIAN_H_
+
+#include "Gaussian.h"
+
+#include <algorithm>
+#include <vector>
+#include <sstream>
+
+namespace dml {
+
+using namespace Eigen;
+
+/**
+ * Gaussian whose metric comes from its full covariance matrix: the scatter of
+ * the members and the impact of the violated constraints (d x d), the metric
+ * is set by decomposeCovMat
+ */
+template <typename Metric, typename Storage = float, typename Acc = float>
+class CovarianceGaussian : public MetricGaussian<Metric, Storage, Acc> {
+public:
+	typedef Gaussian<Storage, Acc> Base;
+	typedef typename Base::ConstDataRef ConstDataRef;
+	typedef typename Base::AccMatrix AccMatrix;
+	typedef typename Base::AccVector AccVector;
+
+	CovarianceGaussian(int id, int size, int dimensions)
+		: MetricGaussian<Metric, Storage, Acc>(id, size, dimensions) {}
+
+	virtual ~CovarianceGaussian(){}
+
+	typedef ComponentParts<Acc, AccMatrix> Parts;
+
+	virtual void updateConstraintImpact(const ConstDataRef& X,
+		const std::vector<int>& vAssign, const ConstraintPtr constraints) {
+		Parts parts;
+		if (CONSTRAINT_COMPONENTS == this->constraintModel) {
+			componentMoments(X, vAssign, constraints->components, parts);
+		}
+		updateConstraintImpact(X, vAssign, constraints, parts);
+	}
+
+	// parts: the component moments of vAssign (CONSTRAINT_COMPONENTS), shared
+	// by the gaussians of one M-step
+	void updateConstraintImpact(const ConstDataRef& X, const std::vector<int>& vAssign,
+		const ConstraintPtr constraints, const Parts& parts) {
+
+		AccMatrix mlImpact, clImpact;
+		if (CONSTRAINT_COMPONENTS == this->constraintModel) {
+			mlImpact = getMLImpact(parts);
+			clImpact = getCLImpact(X, parts, constraints->components);
+		} else {
+			mlImpact = getMLImpact(X, vAssign, constraints->ML);
+			clImpact = getCLImpact(X, vAssign, constraints->CL);
+		}
+		AccMatrix covMat = updateCovMat(X, mlImpact, clImpact, constraints->mlConst, constraints->clConst);
+		AccVector covDiag = decomposeCovMat(covMat);
+		calculateLogDet(covDiag, Acc(nSize));
+
+		if (this->logger) {
+			std::ostringstream message;
+			message << "\t@Cluster " << cltId << ": maxDist = " << maxDist
+				<< "\t logDet = " << logDet << '\n';
+			this->logger(message.str());
+		}
+	}		
+
+	virtual void stepStatistics(const ConstDataRef& X, const int idx,
+		const std::vector<int>& vAssign, const ConstraintPtr constraints) {
+
+		// the terms of updateCovMat that involve idx
+		AccVector centered = X.col(idx).template cast<Acc>() - mean;
+		AccMatrix impact = centered * centered.transpose();
+		for (const int& other : constraints->ML.neighbors(idx)) {
+			if (vAssign[other] != vAssign[idx]) {
+				AccVector diff = accDiff(X, idx, other);
+				impact += Acc(0.5f * constraints->mlConst) * diff * diff.transpose();
+			}
+		}
+		int numViolation = 0;
+		for (const int& other : constraints->CL.neighbors(idx)) {
+			if (vAssign[other] == vAssign[idx]) {
+				numViolation ++;
+				AccVector diff = accDiff(X, idx, other);
+				impact -= Acc(constraints->clConst) * diff * diff.transpose();
+			}
+		}
+		if (numViolation > 0) {
+			this->ensureDiameter(X);
+			AccVector diff = this->farthestDiff(X);
+			impact += Acc(numViolation * constraints->clConst) * diff * diff.transpose();
+		}
+
+		if (0 == nStepped) runningCov = AccMatrix::Zero(nDims, nDims);
+		++nStepped;
+		runningCov += (impact - runningCov) / Acc(nStepped);
+	}
+
+	virtual void commitStatistics(const Acc sizeEstimate) {
+		if (0 == nStepped) return;
+		AccVector covDiag = decomposeCovMat(runningCov);
+		calculateLogDet(covDiag, sizeEstimate);
+	}
+
+protected:
+	using Base::cltId;
+	using Base::nSize;
+	using Base::nDims;
+	using Base::maxDist;
+	using Base::logDet;
+	using Base::members;
+	using Base::mean;
+	using Base::farthest1;
+	using Base::farthest2;
+	using Base::accDiff;
+
+	AccMatrix getMLImpact(const ConstDataRef& X,
+		const std::vector<int>& vAssign, const ConstraintAdjacency& ML) {
+		
+		AccMatrix impact = AccMatrix::Zero(nDims, nDims);
+		for (int idx1 = 0; idx1 < ML.numPoints(); ++idx1) {
+			if ( (GLOBAL_GAUSSIAN_ID == this->cltId) ||
+				(vAssign[idx1] == this->cltId) ){
+				for (const int& idx2 : ML.neighbors(idx1)) {
+					if (vAssign[idx1] != vAssign[idx2]) {
+						AccVector diff = accDiff(X, idx1, idx2);
+						impact += diff * diff.transpose();
+					}
+				}
+			}
+		}
+		return Acc(0.5) * impact;
+	}
+
+	AccMatrix getCLImpact(const ConstDataRef& X,
+		const std::vector<int>& vAssign, const ConstraintAdjacency& CL) {
+
+		AccMatrix impact = AccMatrix::Zero(nDims, nDims);
+		int numViolation = 0;
+		for (int idx1 = 0; idx1 < CL.numPoints(); ++idx1) {
+			if ( (GLOBAL_GAUSSIAN_ID == this->cltId) ||
+				(vAssign[idx1] == this->cltId) ){
+				for (const int& idx2 : CL.neighbors(idx1)) {
+					if (vAssign[idx1] == vAssign[idx2]) {
+						numViolation ++;
+						AccVector diff = accDiff(X, idx1, idx2);
+						impact -= diff * diff.transpose();
+					}
+				}
+			}
+		}
+		if (numViolation > 0) {
+			this->ensureDiameter(X);
+			AccVector diff = this->farthestDiff(X);
+			impact += Acc(numViolation) * diff * diff.transpose();
+		}
+		return impact;
+	}
+
+	AccMatrix getMLImpact(const Parts& parts) {
+		int numViolation = 0;
+		AccMatrix impact = AccMatrix::Zero(nDims, nDims);
+		for (const auto& compParts : parts) {
+			addMustLinkScatter(compParts, cltId, GLOBAL_GAUSSIAN_ID == cltId, impact, numViolation);
+		}
+		return Acc(0.5) * impact;
+	}
+
+	AccMatrix getCLImpact(const ConstDataRef& X, const Parts& parts,
+		const ConstraintComponents& components) {
+
+		AccMatrix impact = AccMatrix::Zero(nDims, nDims);
+		int numViolation = 0;
+		for (int comp1 = 0; comp1 < components.numComponents(); ++comp1) {
+			for (const int& comp2 : components.cannotLinked(comp1)) {
+				if (comp2 < comp1) continue;
+				subtractCannotLinkScatter(parts[comp1], parts[comp2],
+					cltId, GLOBAL_GAUSSIAN_ID == cltId, impact, numViolation);
+			}
+		}
+		if (numViolation > 0) {
+			this->ensureDiameter(X);
+			AccVector diff = this->farthestDiff(X);
+			impact += Acc(numViolation) * diff * diff.transpose();
+		}
+		return impact;
+	}
+
+	AccMatrix updateCovMat(const ConstDataRef& X, const AccMatrix& mlImpact,
+		const AccMatrix& clImpact, const float mlConst, const float clConst) {
+		AccMatrix covMat = scatterMatrix(X);
+		covMat += Acc(mlConst) * mlImpact;
+		covMat += Acc(clConst) * clImpact;
+		covMat /= Acc(nSize);
+		return covMat;
+	}
+
+	// sum of (x - mean)(x - mean)' over the members, the centered members are
+	// gathered by blocks so that the products stay matrix products
+	AccMatrix scatterMatrix(const ConstDataRef& X) {
+		const int BLOCK_SIZE = 256;
+		AccMatrix scatter = AccMatrix::Zero(nDims, nDims);
+		AccMatrix centered(nDims, std::min(BLOCK_SIZE, nSize));
+		for (int first = 0; first < nSize; first += BLOCK_SIZE) {
+			int nCols = std::min(BLOCK_SIZE, nSize - first);
+			for (int k = 0; k < nCols; ++k) {
+				centered.col(k) = X.col(members[first + k]).template cast<Acc>() - mean;
+			}
+			scatter.noalias() += centered.leftCols(nCols) * centered.leftCols(nCols).transpose();
+		}
+		return scatter;
+	}
+
+	// sets the metric from covMat, the eigenvalues of the covariance the
+	// metric stands for (d values)
+	virtual AccVector decomposeCovMat(const AccMatrix& covMat) = 0;
+
+	void calculateLogDet(const AccVector& covDiag, const Acc size) {
+		// logDet = 0.0f;
+		logDet = -covDiag.array().log().sum() / size;
+	}
+
+	int nStepped = 0;			// points seen by stepStatistics
+	AccMatrix runningCov;		// running estimate of the covMat (mini-batch)
+};
+
+} /* namespace dml */
+
+#endif /* GAUSSIAN_COVARIANCEGAUSSIAN_H_ */
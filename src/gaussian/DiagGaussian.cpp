@@ -19,100 +19,272 @@ namespace dml {
 
 using namespace Eigen;
 
-class DiagGaussian : public Gaussian {
+template <typename Storage = float, typename Acc = float>
+class DiagGaussian final : public MetricGaussian<DiagonalMetric, Storage, Acc> {
 public:
+	typedef Gaussian<Storage, Acc> Base;
+	typedef typename Base::ConstDataRef ConstDataRef;
+	typedef typename Base::AccVector AccVector;
+
 	DiagGaussian(int id, int size, int dimensions)
-		: Gaussian(id, size, dimensions) {
-		// when covDiag is not calculated, it is just simple Identity mat
-		// so we the distance that uses covDiad is calculated like Euclidean
-		covDiag = VectorXf::Ones(dimensions);
-	}
+		: MetricGaussian<DiagonalMetric, Storage, Acc>(id, size, dimensions) {}
 
 	virtual ~DiagGaussian(){}
 
-	virtual void updateConstraintImpact(const Ref<const MatrixXf>& X, 
+	typedef ComponentParts<Acc, AccVector> Parts;
+
+	virtual void updateConstraintImpact(const ConstDataRef& X,
 		const std::vector<int>& vAssign, const ConstraintPtr constraints) {
+		Parts parts;
+		if (CONSTRAINT_COMPONENTS == this->constraintModel) {
+			componentMoments(X, vAssign, constraints->components, parts);
+		}
+		updateConstraintImpact(X, vAssign, constraints, parts);
+	}
+
+	// parts: the component moments of vAssign (CONSTRAINT_COMPONENTS), shared
+	// by the gaussians of one M-step
+	void updateConstraintImpact(const ConstDataRef& X, const std::vector<int>& vAssign,
+		const ConstraintPtr constraints, const Parts& parts) {
 
-		VectorXf mlImpact = getMLImpact(X, vAssign, constraints->ML);
-		VectorXf clImpact = getCLImpact(X, vAssign, constraints->CL);
-		updateCovDiag(mlImpact, clImpact, constraints->mlConst, constraints->clConst);
-		calculateLogDet();
+		AccVector mlImpact, clImpact;
+		onlineFarthest.resize(0);
+		if (CONSTRAINT_COMPONENTS == this->constraintModel) {
+			mlImpact = getMLImpact(parts);
+			clImpact = getCLImpact(X, parts, constraints->components);
+		} else {
+			mlImpact = getMLImpact(X, vAssign, constraints->ML);
+			clImpact = getCLImpact(X, vAssign, constraints->CL);
+		}
+		AccVector covDiag = updateCovDiag(X, mlImpact, clImpact, constraints->mlConst, constraints->clConst);
+		calculateLogDet(covDiag, Acc(nSize));
+		// the expanded pairs of a local metric follow the online E-step
+		onlineStatistics = (CONSTRAINT_PAIRS == this->constraintModel) && (GLOBAL_GAUSSIAN_ID != cltId);
 
 		// std::cout << "\tupdate clt " << cltId << ": maxDist = " << maxDist
 		// 	<< "\tfarthest pair: (" << farthest1 << ", " << farthest2 << ")"
 		// 	<< "\tlogDet = " << logDet << '\n';
 	}		
 
+	virtual bool movePoint(const ConstDataRef& X, const int idx, const int oldClt,
+		const std::vector<int>& vAssign, const ConstraintPtr constraints) {
+
+		int newClt = vAssign[idx];
+		if (!onlineStatistics || (cltId != oldClt && cltId != newClt)) return false;
+
+		// Welford: the mean already moved, nSize - 1 -> nSize points when idx
+		// entered, nSize + 1 -> nSize when it left
+		AccVector sqDiff = (X.col(idx).template cast<Acc>() - mean).array().square().matrix();
+		if (cltId == newClt) {
+			scatter += (Acc(nSize) / Acc(nSize - 1)) * sqDiff;
+		} else {
+			scatter -= (Acc(nSize) / Acc(nSize + 1)) * sqDiff;
+		}
+		// the terms of the links of idx, with idx in newClt instead of oldClt
+		addLinkTerms(X, idx, newClt, vAssign, constraints, Acc(1));
+		addLinkTerms(X, idx, oldClt, vAssign, constraints, Acc(-1));
+		// bestCluster reads the distance and logDet of the same covDiag
+		AccVector covDiag = applyStatistics();
+		calculateLogDet(covDiag, Acc(nSize));
+
+		// the farthest pair is kept until the M-step, its distance follows the metric
+		if (this->diameterValid) {
+			this->maxDist = this->farthestScale * metric.distance(X.col(farthest1).template cast<float>(),
+				X.col(farthest2).template cast<float>());
+		}
+		return true;
+	}
+
+	virtual void stepStatistics(const ConstDataRef& X, const int idx,
+		const std::vector<int>& vAssign, const ConstraintPtr constraints) {
+
+		// the terms of updateCovDiag that involve idx
+		AccVector impact = (X.col(idx).template cast<Acc>() - mean).array().square().matrix();
+		for (const int& other : constraints->ML.neighbors(idx)) {
+			if (vAssign[other] != vAssign[idx]) {
+				impact += Acc(0.5f * constraints->mlConst) * accDiff(X, idx, other).array().square().matrix();
+			}
+		}
+		int numViolation = 0;
+		for (const int& other : constraints->CL.neighbors(idx)) {
+			if (vAssign[other] == vAssign[idx]) {
+				numViolation ++;
+				impact -= Acc(constraints->clConst) * accDiff(X, idx, other).array().square().matrix();
+			}
+		}
+		if (numViolation > 0) {
+			this->ensureDiameter(X);
+			impact += Acc(numViolation * constraints->clConst)
+				* this->farthestDiff(X).array().square().matrix();
+		}
+
+		if (0 == nStepped) runningCov = AccVector::Zero(nDims);
+		++nStepped;
+		runningCov += (impact - runningCov) / Acc(nStepped);
+	}
+
+	virtual void commitStatistics(const Acc sizeEstimate) {
+		if (0 == nStepped) return;
+		AccVector covDiag = runningCov.array() + Acc(epsilon);
+		metric.setCovDiag(covDiag.template cast<float>());
+		calculateLogDet(covDiag, sizeEstimate);
+	}
+
 protected:
+	using Base::cltId;
+	using Base::nSize;
+	using Base::nDims;
+	using Base::logDet;
+	using Base::members;
+	using Base::mean;
+	using Base::farthest1;
+	using Base::farthest2;
+	using Base::accDiff;
+	using MetricGaussian<DiagonalMetric, Storage, Acc>::metric;
 
-	VectorXf getMLImpact(const Ref<const MatrixXf>& X, 
-		const std::vector<int>& vAssign, const ConstraintMap& ML) {
+	AccVector getMLImpact(const ConstDataRef& X,
+		const std::vector<int>& vAssign, const ConstraintAdjacency& ML) {
 		
 		int numViolation = 0;
-		VectorXf impact = VectorXf::Zero(nDims);
-		for (const auto& it : ML) {
-			const int idx1 = it.first;
+		AccVector impact = AccVector::Zero(nDims);
+		for (int idx1 = 0; idx1 < ML.numPoints(); ++idx1) {
 			if ( (GLOBAL_GAUSSIAN_ID == this->cltId) || (vAssign[idx1] == this->cltId) ){
-				for (const int& idx2 : it.second) {
+				for (const int& idx2 : ML.neighbors(idx1)) {
 					if (vAssign[idx1] != vAssign[idx2]) {
 						numViolation ++;
-						impact += (X.col(idx1) - X.col(idx2)).array().square().matrix();
+						impact += accDiff(X, idx1, idx2).array().square().matrix();
 					}
 				}
 			}
 		}
-		return 0.5 * impact;
+		return Acc(0.5) * impact;
 	}
 
-	VectorXf getCLImpact(const Ref<const MatrixXf>& X, 
-		const std::vector<int>& vAssign, const ConstraintMap& CL) {
+	AccVector getCLImpact(const ConstDataRef& X,
+		const std::vector<int>& vAssign, const ConstraintAdjacency& CL) {
 
-		VectorXf impact = VectorXf::Zero(nDims);
+		AccVector impact = AccVector::Zero(nDims);
 		int numViolation = 0;
-		for (const auto& it : CL) {
-			const int idx1 = it.first;
+		for (int idx1 = 0; idx1 < CL.numPoints(); ++idx1) {
 			if ( (GLOBAL_GAUSSIAN_ID == this->cltId) || (vAssign[idx1] == this->cltId) ){
-				for (const int& idx2 : it.second) {
+				for (const int& idx2 : CL.neighbors(idx1)) {
 					if (vAssign[idx1] == vAssign[idx2]) {
 						numViolation ++;
-						impact -= (X.col(idx1) - X.col(idx2)).array().square().matrix();
+						impact -= accDiff(X, idx1, idx2).array().square().matrix();
 					}
 				}
 			}
 		}
 
 		if (numViolation > 0) {
-			impact += numViolation * (X.col(farthest1) - X.col(farthest2)).array().square().matrix();
+			this->ensureDiameter(X);
+			onlineFarthest = this->farthestDiff(X).array().square().matrix();
+			impact += numViolation * onlineFarthest;
 		}
 		return impact;
 	}
 
-	void updateCovDiag(const Ref<const VectorXf>& mlImpact, const Ref<const VectorXf>& clImpact,
-		const float mlConst, const float clConst) {
+	AccVector getMLImpact(const Parts& parts) {
+		int numViolation = 0;
+		AccVector impact = AccVector::Zero(nDims);
+		for (const auto& compParts : parts) {
+			addMustLinkScatter(compParts, cltId, GLOBAL_GAUSSIAN_ID == cltId, impact, numViolation);
+		}
+		return Acc(0.5) * impact;
+	}
+
+	AccVector getCLImpact(const ConstDataRef& X, const Parts& parts,
+		const ConstraintComponents& components) {
+
+		AccVector impact = AccVector::Zero(nDims);
+		int numViolation = 0;
+		for (int comp1 = 0; comp1 < components.numComponents(); ++comp1) {
+			for (const int& comp2 : components.cannotLinked(comp1)) {
+				if (comp2 < comp1) continue;
+				subtractCannotLinkScatter(parts[comp1], parts[comp2],
+					cltId, GLOBAL_GAUSSIAN_ID == cltId, impact, numViolation);
+			}
+		}
 
-		covDiag = (data.colwise() - mean).array().square().matrix().rowwise().sum();
-		covDiag += mlConst * mlImpact;
-		covDiag += clConst * clImpact;
-		covDiag /= (1.0f * nSize);
-		covDiag.array() += epsilon;
+		if (numViolation > 0) {
+			this->ensureDiameter(X);
+			impact += numViolation * this->farthestDiff(X).array().square().matrix();
+		}
+		return impact;
 	}
 
-	void calculateLogDet() {
-		logDet = -covDiag.array().abs().log().sum() / nSize;
+	AccVector updateCovDiag(const ConstDataRef& X, const AccVector& mlImpact,
+		const AccVector& clImpact, const float mlConst, const float clConst) {
+
+		scatter = AccVector::Zero(nDims);
+		for (const int& idx : members) {
+			scatter += (X.col(idx).template cast<Acc>() - mean).array().square().matrix();
+		}
+		mlTerm = Acc(mlConst) * mlImpact;
+		clTerm = Acc(clConst) * clImpact;
+		return applyStatistics();
+	}
+
+	// covDiag = (scatter + mlTerm + clTerm) / nSize + epsilon, into the metric
+	AccVector applyStatistics() {
+		AccVector covDiag = scatter;
+		covDiag += mlTerm;
+		covDiag += clTerm;
+		covDiag /= Acc(nSize);
+		covDiag.array() += Acc(epsilon);
+		metric.setCovDiag(covDiag.template cast<float>());
+		return covDiag;
 	}
 
-	virtual float applyDistance(const ConstVectorRef& v1, const ConstVectorRef& v2) {
-		float dist = ( 
-			(v1 - v2).array().square() / 
-			covDiag.array()
-		).sum();
+	/**
+	 * add sign x the terms of mlTerm and clTerm that involve the links of idx,
+	 * idx being in cltOfIdx and the others in vAssign: half a violated ML for
+	 * each end in this cluster, a violated CL inside it counted from both ends
+	 */
+	void addLinkTerms(const ConstDataRef& X, const int idx, const int cltOfIdx,
+		const std::vector<int>& vAssign, const ConstraintPtr constraints, const Acc sign) {
+
+		for (const int& other : constraints->ML.neighbors(idx)) {
+			if (vAssign[other] == cltOfIdx) continue;
+			int nEnds = (cltOfIdx == cltId) + (vAssign[other] == cltId);
+			if (nEnds > 0) {
+				mlTerm += (sign * Acc(0.5f * constraints->mlConst) * Acc(nEnds))
+					* accDiff(X, idx, other).array().square().matrix();
+			}
+		}
+		if (cltOfIdx != cltId) return;
+		int numViolation = 0;
+		for (const int& other : constraints->CL.neighbors(idx)) {
+			if (vAssign[other] == cltOfIdx && other != idx) {
+				numViolation += 2;
+				clTerm -= (sign * Acc(2.0f * constraints->clConst))
+					* accDiff(X, idx, other).array().square().matrix();
+			}
+		}
+		if (numViolation > 0) {
+			// the pair of the M-step, or the first one estimated after it
+			if (0 == onlineFarthest.size()) {
+				this->ensureDiameter(X);
+				onlineFarthest = this->farthestDiff(X).array().square().matrix();
+			}
+			clTerm += (sign * Acc(numViolation * constraints->clConst)) * onlineFarthest;
+		}
+	}
 
-		return (dist > 0.0f) ? std::sqrt(dist) : 0.0f;
+	void calculateLogDet(const AccVector& covDiag, const Acc size) {
+		logDet = -covDiag.array().abs().log().sum() / size;
 	}
 
 protected:
-	VectorXf covDiag;
 	float epsilon = 0.001f;
+	// online E-step (see movePoint): the terms of the last covDiag
+	bool onlineStatistics = false;
+	AccVector scatter;			// sum over the members of (x - mean)^2
+	AccVector mlTerm;			// mlConst x ML impact
+	AccVector clTerm;			// clConst x CL impact
+	AccVector onlineFarthest;	// farthestDiff^2 of the CL impact
+	int nStepped = 0;			// points seen by stepStatistics
+	AccVector runningCov;		// running estimate of the covDiag (mini-batch)
 
 };
 
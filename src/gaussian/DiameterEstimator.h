@@ -0,0 +1,90 @@
+/*
+ * DiameterEstimator.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Farthest pair of points of a cluster (maxDist, farthest1, farthest2),
+ * used by the cannot-link penalty and the CL impact of the metric. maxDist
+ * is never below the diameter, so a violated cannot-link is never rewarded.
+ */
+
+#ifndef GAUSSIAN_DIAMETERESTIMATOR_H_
+#define GAUSSIAN_DIAMETERESTIMATOR_H_
+
+namespace dml {
+
+/**
+ * DIAMETER_EXACT: all pairs, O(N^2) distances
+ * DIAMETER_SWEEP: farthest-point sweeps, O(N) distances, between the diameter
+ * and twice the diameter
+ */
+enum DiameterMethod {
+	DIAMETER_EXACT, DIAMETER_SWEEP
+};
+
+struct Diameter {
+	float maxDist = 0.0f;	// scale x distance of (farthest1, farthest2)
+	int farthest1 = 0;
+	int farthest2 = 0;
+	float scale = 1.0f;
+};
+
+/**
+ * exhaustive scan of all pairs: O(N^2) distances, but no N x N storage.
+ * dist(i, j) returns the distance between points i and j.
+ */
+template <typename DistFunc>
+Diameter exactDiameter(const int nPoints, DistFunc dist) {
+	Diameter diameter;
+	for (int i = 0; i < nPoints - 1; ++i) {
+		for (int j = i + 1; j < nPoints; ++j) {
+			const float d = dist(i, j);
+			if (d > diameter.maxDist) {
+				diameter.maxDist = d;
+				diameter.farthest1 = i;
+				diameter.farthest2 = j;
+			}
+		}
+	}
+	return diameter;
+}
+
+/**
+ * iterated farthest-point sweeps: from a point a, take the farthest point b,
+ * then sweep again from b while the pair gets longer. Each sweep is N
+ * distances. The pair found is at least half the diameter: for the true
+ * farthest pair (x, y), d(x, y) <= d(a, x) + d(a, y) <= 2 max_q d(a, q).
+ * maxDist is twice the pair (scale 2), an upper bound of the diameter.
+ */
+template <typename DistFunc>
+Diameter sweepDiameter(const int nPoints, DistFunc dist, const int maxSweeps = 4) {
+	Diameter diameter;
+	int from = 0;
+	for (int sweep = 0; sweep < maxSweeps; ++sweep) {
+		Diameter farthest;
+		farthest.farthest1 = from;
+		for (int j = 0; j < nPoints; ++j) {
+			const float d = dist(from, j);
+			if (d > farthest.maxDist) {
+				farthest.maxDist = d;
+				farthest.farthest2 = j;
+			}
+		}
+		if (farthest.maxDist <= diameter.maxDist) break;
+		diameter = farthest;
+		from = farthest.farthest2;
+	}
+	diameter.maxDist *= 2.0f;
+	diameter.scale = 2.0f;
+	return diameter;
+}
+
+template <typename DistFunc>
+Diameter estimateDiameter(const DiameterMethod method, const int nPoints, DistFunc dist) {
+	return (DIAMETER_SWEEP == method) ? sweepDiameter(nPoints, dist) : exactDiameter(nPoints, dist);
+}
+
+} /* namespace dml */
+
+#endif /* GAUSSIAN_DIAMETERESTIMATOR_H_ */
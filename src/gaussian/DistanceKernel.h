@@ -0,0 +1,64 @@
+/*
+ * DistanceKernel.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Batched point-to-mean distances in a whitened space (where the metric of
+ * the Gaussian is the Euclidean one): the N x K table is obtained with the
+ * expansion ||x - m||^2 = ||x||^2 + ||m||^2 - 2 x'm, so the work is a single
+ * matrix product X'M instead of N x K calls of applyDistance.
+ */
+
+#ifndef GAUSSIAN_DISTANCEKERNEL_H_
+#define GAUSSIAN_DISTANCEKERNEL_H_
+
+#include <cmath>
+#include "../utils/Eigen3.h"
+
+namespace dml {
+
+// below this fraction of ||x||^2 + ||m||^2, the expansion lost too many digits
+// to cancellation and the distance is evaluated directly
+const static float CANCELLATION_TOLERANCE = 1e-3f;
+
+// columns whitened at once: the whitened copy of the data set is never formed,
+// only d x WHITEN_BLOCK_SIZE floats at a time
+const static int WHITEN_BLOCK_SIZE = 4096;
+
+/**
+ * squared norm of each column
+ */
+inline Eigen::VectorXf squaredColumnNorms(const Eigen::Ref<const Eigen::MatrixXf>& X) {
+	return X.colwise().squaredNorm().transpose();
+}
+
+/**
+ * dist(i, k) = || Xw.col(i) - Mw.col(k) ||
+ * @param Xw whitened points, one column is one point (d x N)
+ * @param xNorms squaredColumnNorms(Xw), precomputed by the caller (N)
+ * @param Mw whitened means, one column is one mean (d x K)
+ * @param dist output (N x K)
+ */
+inline void pointToMeanDistances(const Eigen::Ref<const Eigen::MatrixXf>& Xw,
+	const Eigen::Ref<const Eigen::VectorXf>& xNorms,
+	const Eigen::Ref<const Eigen::MatrixXf>& Mw,
+	Eigen::Ref<Eigen::MatrixXf> dist) {
+
+	Eigen::VectorXf mNorms = squaredColumnNorms(Mw);
+	dist.noalias() = -2.0f * Xw.transpose() * Mw;
+	for (int k = 0; k < Mw.cols(); ++k) {
+		for (int i = 0; i < Xw.cols(); ++i) {
+			float scale = xNorms[i] + mNorms[k];
+			float d2 = dist(i, k) + scale;
+			if (d2 <= CANCELLATION_TOLERANCE * scale) {
+				d2 = (Xw.col(i) - Mw.col(k)).squaredNorm();
+			}
+			dist(i, k) = (d2 > 0.0f) ? std::sqrt(d2) : 0.0f;
+		}
+	}
+}
+
+} /* namespace dml */
+
+#endif /* GAUSSIAN_DISTANCEKERNEL_H_ */
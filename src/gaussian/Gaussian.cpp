@@ -8,128 +8,185 @@
 #include "Gaussian.h"
 #include <iostream>
 #include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include <vector>
 
 namespace dml {
 
 using namespace Eigen;
 
-Gaussian::Gaussian(const int id, const int size, const int dimensions) {
+template <typename Storage, typename Acc>
+Gaussian<Storage, Acc>::Gaussian(const int id, const int size, const int dimensions) {
 	cltId = id;
-	nSize = size;
 	nDims = dimensions;
 
-	mean = VectorXf(nDims);
-	data = MatrixXf(nDims, nSize);
-	adaptNewSize (nSize);
+	mean = AccVector(nDims);
+	members.reserve(size);
+	resetStatistics();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // PUBLIC APIs
 ///////////////////////////////////////////////////////////////////////////////
 
-void Gaussian::adaptNewSize(const int size) {
-	nSize = size;
-	nAssigned = 0;
-	//assert((nSize > 0) && "EMPTY GAUSSIAN!");
-	if (0 == nSize) {
-		throw std::runtime_error("Can not create empty gaussian\n");
-	}
-	data.resize(nDims, nSize);
+template <typename Storage, typename Acc>
+void Gaussian<Storage, Acc>::resetStatistics() {
+	nSize = 0;
+	members.clear();	// keeps the capacity for the next E-step
+	sumX = AccVector::Zero(nDims);
 }
 
-void Gaussian::insertDataPoint(const ConstVectorRef& dp) {
-	assert((nAssigned < nSize) && "CAN NOT INSERT DATAPOINT TO GAUSSIAN");
-	data.col(nAssigned) = dp;
-	nAssigned++;
-}
-
-void Gaussian::setData(const ConstMatrixRef& X) {
-	nAssigned = X.cols();
+template <typename Storage, typename Acc>
+void Gaussian<Storage, Acc>::addAllPoints(const ConstDataRef& X) {
 	nSize = X.cols();
-	data = X;
-}
-
-float Gaussian::distance(const int idx1, const int idx2) {
-	return distP2P(idx1, idx2);
-}
-
-float Gaussian::distanceToMean(const int idx) {
-	return distP2M[idx];
-}
-
-/*virtual*/ void Gaussian::cacheDistPoint2Point(const ConstMatrixRef& Xp) {
-	maxDist = 0.0f;
-	if (0 == distP2P.cols() && 0 == distP2P.rows()) {
-		distP2P = MatrixXf(Xp.cols(), Xp.cols());
-	} else {
-		distP2P.setZero();
-	}
-
-	for (int i = 0; i < Xp.cols() - 1; ++i) {
-		for (int j = i; j < Xp.cols(); ++j) {
-			const float dist = applyDistance(Xp.col(i), Xp.col(j));
-			distP2P(i, j) = dist;
-			distP2P(j, i) = dist;
-			if (dist > maxDist) {
-				maxDist = dist;
-				farthest1 = i;
-				farthest2 = j;
-			}
-		}
+	members.resize(nSize);
+	for (int idx = 0; idx < nSize; ++idx) {
+		members[idx] = idx;
 	}
+	sumX = X.template cast<Acc>().rowwise().sum();
 }
 
-/*virtual*/ void Gaussian::cacheDistPoint2Mean(const ConstMatrixRef& Xp) {
-	if (0 == distP2M.size()) {
-		distP2M = VectorXf(Xp.cols());
-	} else {
-		distP2M.setZero();
+template <typename Storage, typename Acc>
+float Gaussian<Storage, Acc>::distance(const int idx1, const int idx2) {
+	int linkIdx = pairConstraints->ML.linkIndex(idx1, idx2);
+	if (linkIdx >= 0) {
+		return distML[linkIdx];
 	}
-	for (int i = 0; i < Xp.cols(); ++i) {
-		distP2M[i] = applyDistance(Xp.col(i), mean);
+	linkIdx = pairConstraints->CL.linkIndex(idx1, idx2);
+	if (linkIdx >= 0) {
+		return distCL[linkIdx];
 	}
+	throw std::runtime_error("Distance is only cached for constrained pairs\n");
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // PUBLIC APIS - GETTER SETTER
 ///////////////////////////////////////////////////////////////////////////////
 
-int Gaussian::getClusterId()
+template <typename Storage, typename Acc>
+int Gaussian<Storage, Acc>::getClusterId()
 {
 	return cltId;
 }
 
-float Gaussian::getMaxDistance()
-{
-	return maxDist;
-}
-
-float Gaussian::getLogDet()
-{
-	return logDet;
-}
-
-const Eigen::VectorXf Gaussian::getMean()
+template <typename Storage, typename Acc>
+const typename Gaussian<Storage, Acc>::AccVector Gaussian<Storage, Acc>::getMean()
 {
 	return mean;
 }
 
-void Gaussian::setInitCenter(const ConstVectorRef& initCenter) {
-	mean = initCenter;
+template <typename Storage, typename Acc>
+void Gaussian<Storage, Acc>::setInitCenter(const ConstVectorRef& initCenter) {
+	mean = initCenter.template cast<Acc>();
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // PRIVATE METHODS
 ///////////////////////////////////////////////////////////////////////////////
 
-void Gaussian::updateMean()
+template <typename Storage, typename Acc>
+void Gaussian<Storage, Acc>::cachePairDistances(const ConstDataRef& X,
+	const ConstraintPtr constraints) {
+	pairConstraints = constraints;
+	diameterValid = false;	// the metric changed
+
+	// memory is linear in the number of constrained points, not in X
+	int nPoints = std::max(constraints->ML.numPoints(), constraints->CL.numPoints());
+	std::vector<int> position(nPoints, -1);
+	std::vector<int> linked;
+	for (int idx = 0; idx < nPoints; ++idx) {
+		if (constraints->ML.hasLinks(idx) || constraints->CL.hasLinks(idx)) {
+			position[idx] = (int) linked.size();
+			linked.push_back(idx);
+		}
+	}
+	DataMatrix Xc(nDims, linked.size());
+	for (size_t k = 0; k < linked.size(); ++k) {
+		Xc.col(k) = X.col(linked[k]);
+	}
+	Eigen::MatrixXf Xw = whiten(Xc);
+	cachePairDistances(Xw, position, constraints->ML, distML);
+	cachePairDistances(Xw, position, constraints->CL, distCL);
+}
+
+template <typename Storage, typename Acc>
+void Gaussian<Storage, Acc>::updateDiameter(const ConstDataRef& X) {
+	Diameter diameter;
+	if (DIAMETER_SWEEP == diameterMethod) {
+		// O(N) distances, evaluated without whitening X
+		diameter = sweepDiameter(X.cols(), [&](int i, int j) {
+			return applyDistance(X.col(i), X.col(j));
+		});
+	} else {
+		// all pairs, between two blocks of whitened points at a time; a tie
+		// keeps the first pair in (i, j) order, as exactDiameter
+		int nPoints = X.cols();
+		for (int first1 = 0; first1 < nPoints; first1 += WHITEN_BLOCK_SIZE) {
+			int nCols1 = std::min(WHITEN_BLOCK_SIZE, nPoints - first1);
+			Eigen::MatrixXf block1 = whiten(X.middleCols(first1, nCols1));
+			for (int first2 = first1; first2 < nPoints; first2 += WHITEN_BLOCK_SIZE) {
+				int nCols2 = std::min(WHITEN_BLOCK_SIZE, nPoints - first2);
+				Eigen::MatrixXf block2;
+				if (first2 != first1) block2 = whiten(X.middleCols(first2, nCols2));
+				const Eigen::MatrixXf& other = (first2 == first1) ? block1 : block2;
+				for (int i = 0; i < nCols1; ++i) {
+					for (int j = (first2 == first1) ? i + 1 : 0; j < nCols2; ++j) {
+						const float d = (block1.col(i) - other.col(j)).norm();
+						if (d > diameter.maxDist || (d == diameter.maxDist && d > 0.0f
+							&& std::make_pair(first1 + i, first2 + j)
+								< std::make_pair(diameter.farthest1, diameter.farthest2))) {
+							diameter.maxDist = d;
+							diameter.farthest1 = first1 + i;
+							diameter.farthest2 = first2 + j;
+						}
+					}
+				}
+			}
+		}
+	}
+	maxDist = diameter.maxDist;
+	farthest1 = diameter.farthest1;
+	farthest2 = diameter.farthest2;
+	farthestScale = diameter.scale;
+	diameterValid = true;
+}
+
+template <typename Storage, typename Acc>
+void Gaussian<Storage, Acc>::cachePairDistances(const ConstMatrixRef& Xw,
+	const std::vector<int>& position, const ConstraintAdjacency& links, VectorXf& distLinks) {
+	// memory is linear in the number of constraints, each pair is evaluated
+	// once and stored in both directions
+	distLinks.resize(links.numLinks());
+	for (int idx1 = 0; idx1 < links.numPoints(); ++idx1) {
+		ConstraintAdjacency::Range neighbors = links.neighbors(idx1);
+		for (int k = 0; k < neighbors.size(); ++k) {
+			int idx2 = neighbors.first[k];
+			if (idx2 < idx1) continue;
+			const float dist = (Xw.col(position[idx1]) - Xw.col(position[idx2])).norm();
+			distLinks[neighbors.offset + k] = dist;
+			distLinks[links.linkIndex(idx2, idx1)] = dist;
+		}
+	}
+}
+
+template <typename Storage, typename Acc>
+void Gaussian<Storage, Acc>::updateMean()
 {
-	mean = data.rowwise().mean();
+	if (0 == nSize) {
+		throw std::runtime_error("Can not update empty gaussian\n");
+	}
+	mean = sumX / Acc(nSize);
 }
 
-void Gaussian::debugCachedDistance() {
-	std::cout << "Debug cache point p2p: \n"  << distP2P.block(0, 0, 10, 10) << '\n';
-	std::cout << "Debug cache point p2Mean: \n"  << distP2M.head(10).transpose() << '\n';
+template <typename Storage, typename Acc>
+void Gaussian<Storage, Acc>::debugCachedDistance() {
+	std::cout << "Debug cache ML pairs: \n"  << distML.head(std::min<Index>(10, distML.size())).transpose() << '\n';
+	std::cout << "Debug cache CL pairs: \n"  << distCL.head(std::min<Index>(10, distCL.size())).transpose() << '\n';
 }
 
+template class Gaussian<float, float>;
+template class Gaussian<float, double>;
+template class Gaussian<Eigen::half, float>;
+
 } /* namespace dml */
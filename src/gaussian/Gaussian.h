@@ -10,62 +10,254 @@
 
 #include "../utils/Eigen3.h"
 #include "../constraint/ConstraintsManager.h"
+#include "ComponentMoments.h"
+#include "DiameterEstimator.h"
+#include "DistanceKernel.h"
+#include "MetricPolicy.h"
+#include <algorithm>
+#include <functional>
+#include <string>
 #include <vector>
 
 namespace dml {
 
-typedef Eigen::Ref<const Eigen::VectorXf> ConstVectorRef;
-typedef Eigen::Ref<const Eigen::MatrixXf> ConstMatrixRef;
 const static int GLOBAL_GAUSSIAN_ID = -1;
 
+/**
+ * receives the progress messages of a run, one line each (with its '\n'),
+ * possibly from several threads of the run at once
+ */
+typedef std::function<void(const std::string&)> LogFunc;
+
+/**
+ * Storage: scalar of the data points (Eigen::half, float)
+ * Acc: scalar of the accumulations (mean, covariance, decomposition)
+ * the cached distances are float whatever the scalar types
+ */
+template <typename Storage = float, typename Acc = float>
 class Gaussian {
 public:
+	typedef Eigen::MatrixX<Storage> DataMatrix;
+	typedef Eigen::Ref<const Eigen::MatrixX<Storage> > ConstDataRef;
+	typedef Eigen::Ref<const Eigen::VectorX<Storage> > ConstPointRef;
+	typedef Eigen::MatrixX<Acc> AccMatrix;
+	typedef Eigen::VectorX<Acc> AccVector;
+
 	Gaussian(const int id, const int size, const int dimensions);
 	virtual ~Gaussian(){}
 
 	int getClusterId();
-	float getMaxDistance();
-	float getLogDet();
-	const Eigen::VectorXf getMean();
+	// diameter of X under this metric, estimated on the first call after the
+	// metric changed (only when some cannot-link needs it)
+	float getMaxDistance(const ConstDataRef& X) {
+		ensureDiameter(X);
+		return maxDist;
+	}
+	void ensureDiameter(const ConstDataRef& X) {
+		if (!diameterValid) updateDiameter(X);
+	}
+	void setDiameterMethod(const DiameterMethod method) {
+		diameterMethod = method;
+		diameterValid = false;
+	}
+	// CONSTRAINT_COMPONENTS: impacts from the component aggregates, no pair cached
+	void setConstraintModel(const ConstraintModel model) { constraintModel = model; }
+	// empty = silent (default)
+	void setLogger(const LogFunc& log) { logger = log; }
+	// number of eigenpairs of a low-rank metric (LowRankMetric), ignored by the others
+	virtual void setMetricRank(const int rank) {}
+	float getLogDet() { return logDet; }
+	const AccVector getMean();
 	void setInitCenter(const ConstVectorRef& initCenter);
 
-	void adaptNewSize(const int size);
-	void insertDataPoint(const ConstVectorRef& dp);
+	/**
+	 * sufficient statistics of the member points: their ids, count and sum,
+	 * built in one pass over the assignment, the points are never copied
+	 */
+	void resetStatistics();
+	void addPoint(const ConstDataRef& X, const int idx) {
+		members.push_back(idx);
+		sumX += X.col(idx).template cast<Acc>();
+		++nSize;
+	}
+	// online update of count, sum and mean when the point x enters or leaves
+	// the gaussian during the E-step, the member ids are rebuilt after it
+	void addToMean(const ConstPointRef& x) {
+		sumX += x.template cast<Acc>();
+		++nSize;
+		mean = sumX / Acc(nSize);
+	}
+	void removeFromMean(const ConstPointRef& x) {
+		sumX -= x.template cast<Acc>();
+		--nSize;
+		mean = sumX / Acc(nSize);
+	}
+	/**
+	 * online E-step, after the means moved: X.col(idx) left oldClt for
+	 * vAssign[idx]. A metric whose statistics decompose per point follows the
+	 * move, true when it changed (its cached link distances are then stale
+	 * until the M-step); the others keep their metric until the M-step
+	 */
+	virtual bool movePoint(const ConstDataRef& X, const int idx, const int oldClt,
+		const std::vector<int>& vAssign, const ConstraintPtr constraints) { return false; }
+	// all points of X are members (global gaussian)
+	void addAllPoints(const ConstDataRef& X);
+	int getSize() const { return nSize; }
+	const std::vector<int>& getMembers() const { return members; }
 
-	void setData(const ConstMatrixRef& X);
+	/**
+	 * mini-batch: the mean moves toward each point of the batch with the
+	 * decaying rate 1 / (points seen), the metric statistics follow the same
+	 * points (stepStatistics) and are applied to the metric by commitStatistics
+	 */
+	void stepMean(const ConstPointRef& x) {
+		++nSeen;
+		mean += (x.template cast<Acc>() - mean) / Acc(nSeen);
+	}
+	int getSeen() const { return nSeen; }
+	// the scatter of X.col(idx) and the impact of its violated links
+	virtual void stepStatistics(const ConstDataRef& X, const int idx,
+		const std::vector<int>& vAssign, const ConstraintPtr constraints) {}
+	// sizeEstimate: expected number of members, normalizes logDet
+	virtual void commitStatistics(const Acc sizeEstimate) {}
 
 	void updateMean();
-	virtual void updateConstraintImpact(const ConstMatrixRef& X, 
+	virtual void updateConstraintImpact(const ConstDataRef& X,
 		const std::vector<int>& vAssign, const ConstraintPtr constraints) = 0;
-	virtual void cacheDistPoint2Point(const ConstMatrixRef& X);
-	virtual void cacheDistPoint2Mean(const ConstMatrixRef& X);
+	virtual void cacheConstraintDistances(const ConstDataRef& X, const ConstraintPtr constraints) = 0;
+	// dist[i] = distance of X.col(i) to the mean
+	virtual void cacheDistPoint2Mean(const ConstDataRef& X, Eigen::Ref<Eigen::VectorXf> dist) = 0;
 
+	// distance of a constrained pair, only cached for the links in ML or CL
 	float distance(const int idx1, const int idx2);
-	float distanceToMean(const int idx);
+	// distance of the link at position linkIdx in the adjacency of ML / CL
+	float mlDistance(const int linkIdx) { return distML[linkIdx]; }
+	float clDistance(const int linkIdx) { return distCL[linkIdx]; }
 
 	void debugCachedDistance();
-	
+
 	// note euclidean dis is special case when DIAG_COV = I
-	virtual float applyDistance(const ConstVectorRef& v1, const ConstVectorRef& v2) = 0;
+	virtual float applyDistance(const ConstPointRef& v1, const ConstPointRef& v2) = 0;
+
+	// distance of the point x to center under the metric of this gaussian
+	virtual float distanceToCenter(const ConstPointRef& x, const ConstVectorRef& center) = 0;
+
+	// map points (one per column) to the space where the metric of this
+	// gaussian is the euclidean distance: applyDistance(a, b) = |W a - W b|
+	virtual Eigen::MatrixXf whiten(const ConstDataRef& X) = 0;
+
+	// the learned metric and its logDet, to seed another run (warm start)
+	virtual void getMetricParameters(Eigen::VectorXf& covDiag, Eigen::MatrixXf& rotation) = 0;
+	virtual void setMetricParameters(const ConstVectorRef& covDiag,
+		const ConstMatrixRef& rotation, const float logDeterminant) = 0;
 
 protected:
+	// only the points with a link are whitened (see whiten())
+	void cachePairDistances(const ConstDataRef& X, const ConstraintPtr constraints);
+	// Xw: the whitened points with a link, position[idx]: the column of idx in Xw
+	void cachePairDistances(const ConstMatrixRef& Xw, const std::vector<int>& position,
+		const ConstraintAdjacency& links, Eigen::VectorXf& distLinks);
+
+	void updateDiameter(const ConstDataRef& X);
+
+	// X.col(idx1) - X.col(idx2) evaluated in the accumulation type
+	static auto accDiff(const ConstDataRef& X, const int idx1, const int idx2) {
+		return X.col(idx1).template cast<Acc>() - X.col(idx2).template cast<Acc>();
+	}
+	// the farthest pair scaled to maxDist, the diameter term of the CL impacts
+	auto farthestDiff(const ConstDataRef& X) const {
+		return Acc(farthestScale) * accDiff(X, farthest1, farthest2);
+	}
 
 	int cltId = 0;
-	int nAssigned = 0;
-	int nSize = 0;
+	int nSize = 0;			// number of member points
+	int nSeen = 0;			// points seen by stepMean (mini-batch)
 	int nDims = 0;
 	float maxDist = 0.0f;
 	float logDet = 0.0f;
-	
-	Eigen::MatrixXf data;
-	Eigen::VectorXf mean;
 
-	Eigen::MatrixXf distP2P;
-	Eigen::VectorXf distP2M;
+	std::vector<int> members;	// ids of the member points in the data set
+	AccVector sumX;				// sum of the member points
+	AccVector mean;
+
+	ConstraintPtr pairConstraints;	// the constraints of the cached pairs
+	Eigen::VectorXf distML;		// distance of each link of ML (CSR order)
+	Eigen::VectorXf distCL;		// distance of each link of CL (CSR order)
 	int farthest1 = 0;
 	int farthest2 = 0;
+	float farthestScale = 1.0f;		// maxDist = farthestScale x distance of the pair
+	DiameterMethod diameterMethod = DIAMETER_EXACT;
+	bool diameterValid = false;		// maxDist / farthest1 / farthest2 match the metric
+	ConstraintModel constraintModel = CONSTRAINT_PAIRS;
+	LogFunc logger;					// empty = silent
 };
 
+/**
+ * Gaussian whose metric is the policy Metric (see MetricPolicy.h). The virtual
+ * applyDistance / whiten are kept for the callers that only know Gaussian,
+ * the code that knows the concrete type calls the policy without dispatch.
+ */
+template <typename Metric, typename Storage = float, typename Acc = float>
+class MetricGaussian : public Gaussian<Storage, Acc> {
+public:
+	typedef Gaussian<Storage, Acc> Base;
+	typedef typename Base::ConstDataRef ConstDataRef;
+	typedef typename Base::ConstPointRef ConstPointRef;
+
+	MetricGaussian(const int id, const int size, const int dimensions)
+		: Base(id, size, dimensions), metric(dimensions) {}
+
+	virtual void cacheConstraintDistances(const ConstDataRef& X, const ConstraintPtr constraints) final {
+		if (CONSTRAINT_COMPONENTS == this->constraintModel) {
+			this->diameterValid = false;	// only the diameter depends on the metric
+			return;
+		}
+		this->cachePairDistances(X, constraints);
+	}
+
+	virtual void cacheDistPoint2Mean(const ConstDataRef& X, Eigen::Ref<Eigen::VectorXf> dist) final {
+		Eigen::MatrixXf meanW = metric.whiten(this->mean);
+		for (Eigen::Index first = 0; first < X.cols(); first += WHITEN_BLOCK_SIZE) {
+			Eigen::Index nCols = std::min<Eigen::Index>(WHITEN_BLOCK_SIZE, X.cols() - first);
+			Eigen::MatrixXf blockW = metric.whiten(X.middleCols(first, nCols));
+			pointToMeanDistances(blockW, squaredColumnNorms(blockW), meanW, dist.segment(first, nCols));
+		}
+	}
+
+	virtual float applyDistance(const ConstPointRef& v1, const ConstPointRef& v2) final {
+		return metric.distance(v1.template cast<float>(), v2.template cast<float>());
+	}
+
+	virtual float distanceToCenter(const ConstPointRef& x, const ConstVectorRef& center) final {
+		return metric.distance(x.template cast<float>(), center);
+	}
+
+	virtual Eigen::MatrixXf whiten(const ConstDataRef& X) final {
+		return metric.whiten(X);
+	}
+
+	virtual void getMetricParameters(Eigen::VectorXf& covDiag, Eigen::MatrixXf& rotation) final {
+		metric.getParameters(covDiag, rotation);
+	}
+
+	virtual void setMetricParameters(const ConstVectorRef& covDiag,
+		const ConstMatrixRef& rotation, const float logDeterminant) final {
+		metric.setParameters(covDiag, rotation);
+		this->logDet = logDeterminant;
+		this->diameterValid = false;
+	}
+
+	const Metric& getMetric() const { return metric; }
+	void setMetric(const Metric& m) { metric = m; }
+
+protected:
+	Metric metric;
+};
+
+extern template class Gaussian<float, float>;
+extern template class Gaussian<float, double>;
+extern template class Gaussian<Eigen::half, float>;
+
 } /* namespace dml */
 
 #endif /* GAUSSIAN_GAUSSIAN_H_ */
@@ -0,0 +1,122 @@
+/*
+ * LowRankGaussian.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ */
+
+#ifndef GAUSSIAN_LOWRANKGAUSSIAN_
+#define GAUSSIAN_LOWRANKGAUSSIAN_
+
+#include "CovarianceGaussian.h"
+#include "SymmetricDecomposition.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace dml {
+
+using namespace Eigen;
+
+/**
+ * the covariance is approximated by its r leading eigenpairs and one variance
+ * for the rest of the spectrum (see LowRankMetric). The eigenpairs come from a
+ * randomized range finder: covMat is multiplied by r + RANGE_OVERSAMPLING
+ * random directions, sharpened by RANGE_POWER_ITERATIONS products, and the
+ * small projected matrix is diagonalized, O(d^2 r) instead of the O(d^3) SVD
+ */
+template <typename Storage = float, typename Acc = float>
+class LowRankGaussian final : public CovarianceGaussian<LowRankMetric, Storage, Acc> {
+public:
+	typedef CovarianceGaussian<LowRankMetric, Storage, Acc> Base;
+	typedef typename Base::AccMatrix AccMatrix;
+	typedef typename Base::AccVector AccVector;
+
+	LowRankGaussian(int id, int size, int dimensions)
+		: Base(id, size, dimensions) {}
+
+	virtual ~LowRankGaussian(){}
+
+	virtual void setMetricRank(const int rank) { metricRank = rank; }
+
+protected:
+	using Base::cltId;
+	using Base::nDims;
+	using MetricGaussian<LowRankMetric, Storage, Acc>::metric;
+
+	static const int RANGE_OVERSAMPLING = 10;
+	static const int RANGE_POWER_ITERATIONS = 2;
+	static const unsigned RANGE_SEED = 20150622;
+
+	virtual AccVector decomposeCovMat(const AccMatrix& covMat) {
+		int rank = std::max(1, std::min(metricRank, nDims - 1));
+		int nSamples = std::min(nDims, rank + RANGE_OVERSAMPLING);
+
+		// the same directions at each call, the run does not depend on std::rand
+		std::mt19937 generator(RANGE_SEED + cltId);
+		std::normal_distribution<double> normal;
+		AccMatrix range(nDims, nSamples);
+		for (int col = 0; col < nSamples; ++col) {
+			for (int row = 0; row < nDims; ++row) {
+				range(row, col) = Acc(normal(generator));
+			}
+		}
+		AccMatrix basis = orthonormalize(covMat * range);
+		for (int iter = 0; iter < RANGE_POWER_ITERATIONS; ++iter) {
+			basis = orthonormalize(covMat * basis);
+		}
+		AccMatrix projected = basis.transpose() * covMat * basis;
+		SelfAdjointEigenSolver<AccMatrix> solver(projected);
+
+		// largest first. The cannot-link impact can make covMat indefinite: it
+		// is repaired as in the full path (SymmetricDecomposition.h), the
+		// leading values and the residual are shifted by the same jitter, so
+		// that the smallest of them reaches DEFINITENESS_TOLERANCE x the largest
+		std::vector<int> order(nSamples);
+		for (int k = 0; k < nSamples; ++k) order[k] = k;
+		const AccVector& values = solver.eigenvalues();
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return values[a] > values[b];
+		});
+
+		AccVector spectrum(nDims);
+		AccMatrix leading(nDims, rank);
+		Acc sumLeading = 0;
+		for (int k = 0; k < rank; ++k) {
+			spectrum[k] = values[order[k]];
+			sumLeading += values[order[k]];
+			leading.col(k) = basis * solver.eigenvectors().col(order[k]);
+		}
+		// the mean of the rest of the spectrum, never above the leading ones
+		Acc residual = spectrum[rank - 1];
+		if (nDims > rank) {
+			residual = std::min((covMat.trace() - sumLeading) / Acc(nDims - rank), spectrum[rank - 1]);
+		}
+		Acc largest = std::max(std::abs(spectrum[0]), std::abs(residual));
+		Acc floor = Acc(DEFINITENESS_TOLERANCE) * ((largest > 0) ? largest : Acc(1));
+		Acc jitter = std::max(Acc(0), floor - residual);
+		spectrum.head(rank).array() += jitter;
+		residual += jitter;
+		spectrum.tail(nDims - rank).setConstant(residual);
+
+		VectorXf parameters(rank + 1);
+		parameters.head(rank) = spectrum.head(rank).template cast<float>();
+		parameters[rank] = float(residual);
+		metric.setDecomposition(parameters, leading.transpose().template cast<float>());
+		return spectrum;
+	}
+
+	// orthonormal basis of the columns of M
+	static AccMatrix orthonormalize(const AccMatrix& M) {
+		HouseholderQR<AccMatrix> qr(M);
+		return qr.householderQ() * AccMatrix::Identity(M.rows(), M.cols());
+	}
+
+	int metricRank = DEFAULT_METRIC_RANK;	// r, the leading eigenpairs kept
+};
+
+} /* namespace dml */
+
+#endif /* GAUSSIAN_LOWRANKGAUSSIAN_ */
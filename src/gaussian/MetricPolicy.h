@@ -0,0 +1,310 @@
+/*
+ * MetricPolicy.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Compile-time metric policies: the parameters of one metric and the inline
+ * (non virtual) evaluation of its distance, in float whatever the storage type
+ * of the points. A Gaussian owns one policy and the algorithms are instantiated
+ * once per policy, so the metric is chosen once per run instead of once per
+ * distance.
+ *   EuclideanMetric  |a - b|
+ *   DiagonalMetric   |diag(1 / sqrt(covDiag)) (a - b)|
+ *   FullMetric       |diag(1 / sqrt(covDiag)) trans (a - b)|, covMat = trans' diag(covDiag) trans
+ *   LowRankMetric    FullMetric with the r leading eigenpairs only, the rest of
+ *                    the spectrum is one variance: O(d r) per distance
+ */
+
+#ifndef GAUSSIAN_METRICPOLICY_H_
+#define GAUSSIAN_METRICPOLICY_H_
+
+#include <algorithm>
+#include <cmath>
+
+#include "../utils/Eigen3.h"
+
+namespace dml {
+
+typedef Eigen::Ref<const Eigen::VectorXf> ConstVectorRef;
+typedef Eigen::Ref<const Eigen::MatrixXf> ConstMatrixRef;
+
+enum CovType {
+	COV_NONE, COV_DIAG, COV_FULL, COV_LOWRANK
+};
+
+template <typename Storage, typename Acc> class SimpleGaussian;
+template <typename Storage, typename Acc> class DiagGaussian;
+template <typename Storage, typename Acc> class FullGaussian;
+template <typename Storage, typename Acc> class LowRankGaussian;
+
+struct EuclideanMetric {
+	template <typename Storage, typename Acc>
+	using GaussianType = SimpleGaussian<Storage, Acc>;
+	static const CovType covType = COV_NONE;
+
+	explicit EuclideanMetric(const int dimensions) {}
+
+	template <typename V1, typename V2>
+	float distance(const Eigen::MatrixBase<V1>& v1, const Eigen::MatrixBase<V2>& v2) const {
+		return (v1 - v2).norm();
+	}
+
+	template <typename Derived>
+	Eigen::MatrixXf whiten(const Eigen::MatrixBase<Derived>& X) const {
+		return X.template cast<float>();
+	}
+
+	/**
+	 * sMin * previous.distance(a, b) <= distance(a, b) <= sMax * previous.distance(a, b)
+	 */
+	void distortionFrom(const EuclideanMetric& previous, float& sMin, float& sMax) const {
+		sMin = sMax = 1.0f;
+	}
+
+	/**
+	 * the learned parameters (covDiag, trans), empty when not used, to seed
+	 * another run with the same metric
+	 */
+	void getParameters(Eigen::VectorXf& cov, Eigen::MatrixXf& rotation) const {
+		cov.resize(0);
+		rotation.resize(0, 0);
+	}
+	void setParameters(const ConstVectorRef& cov, const ConstMatrixRef& rotation) {}
+};
+
+struct DiagonalMetric {
+	template <typename Storage, typename Acc>
+	using GaussianType = DiagGaussian<Storage, Acc>;
+	static const CovType covType = COV_DIAG;
+
+	// when covDiag is not calculated, it is just simple Identity mat
+	explicit DiagonalMetric(const int dimensions)
+		: covDiag(Eigen::VectorXf::Ones(dimensions)),
+		  invStdDev(Eigen::VectorXf::Ones(dimensions)) {}
+
+	void setCovDiag(const ConstVectorRef& cov) {
+		covDiag = cov;
+		invStdDev = covDiag.cwiseSqrt().cwiseInverse();
+	}
+
+	template <typename V1, typename V2>
+	float distance(const Eigen::MatrixBase<V1>& v1, const Eigen::MatrixBase<V2>& v2) const {
+		return (v1 - v2).cwiseProduct(invStdDev).norm();
+	}
+
+	template <typename Derived>
+	Eigen::MatrixXf whiten(const Eigen::MatrixBase<Derived>& X) const {
+		return invStdDev.asDiagonal() * X.template cast<float>();
+	}
+
+	void distortionFrom(const DiagonalMetric& previous, float& sMin, float& sMax) const {
+		Eigen::VectorXf ratio = invStdDev.cwiseQuotient(previous.invStdDev);
+		sMin = ratio.minCoeff();
+		sMax = ratio.maxCoeff();
+	}
+
+	void getParameters(Eigen::VectorXf& cov, Eigen::MatrixXf& rotation) const {
+		cov = covDiag;
+		rotation.resize(0, 0);
+	}
+	void setParameters(const ConstVectorRef& cov, const ConstMatrixRef& rotation) {
+		setCovDiag(cov);
+	}
+
+	Eigen::VectorXf covDiag;
+	Eigen::VectorXf invStdDev;
+};
+
+struct FullMetric {
+	template <typename Storage, typename Acc>
+	using GaussianType = FullGaussian<Storage, Acc>;
+	static const CovType covType = COV_FULL;
+
+	// before the first decomposition the metric is the Euclidean one (W is empty)
+	explicit FullMetric(const int dimensions)
+		: covDiag(Eigen::VectorXf::Ones(dimensions)) {}
+
+	void setDecomposition(const ConstVectorRef& cov, const ConstMatrixRef& rotation) {
+		covDiag = cov;
+		trans = rotation;
+		W = covDiag.cwiseSqrt().cwiseInverse().asDiagonal() * trans;
+		lowerW = W.isLowerTriangular(0.0f);
+	}
+
+	template <typename V1, typename V2>
+	float distance(const Eigen::MatrixBase<V1>& v1, const Eigen::MatrixBase<V2>& v2) const {
+		if (0 == W.size()) {
+			return (v1 - v2).norm();
+		}
+		Eigen::VectorXf diff = v1 - v2;
+		return lowerW ? (W.triangularView<Eigen::Lower>() * diff).norm() : (W * diff).norm();
+	}
+
+	template <typename Derived>
+	Eigen::MatrixXf whiten(const Eigen::MatrixBase<Derived>& X) const {
+		if (0 == W.size()) {
+			return X.template cast<float>();
+		}
+		if (lowerW) {
+			// evaluated first, the triangular product of a vector expression
+			// can not be assigned to a matrix
+			Eigen::MatrixXf Xf = X.template cast<float>();
+			return W.triangularView<Eigen::Lower>() * Xf;
+		}
+		return W * X.template cast<float>();
+	}
+
+	// inverse(W): trans' diag(sqrt(covDiag)) when trans is orthogonal
+	Eigen::MatrixXf inverseW() const {
+		int nDims = covDiag.size();
+		if (0 == W.size()) {
+			return Eigen::MatrixXf::Identity(nDims, nDims);
+		}
+		if (lowerW) {
+			return W.triangularView<Eigen::Lower>().solve(Eigen::MatrixXf::Identity(nDims, nDims));
+		}
+		return trans.transpose() * covDiag.cwiseSqrt().asDiagonal();
+	}
+
+	// the extreme singular values of W inv(previous.W), from the eigenvalues
+	// of the symmetric M' M
+	void distortionFrom(const FullMetric& previous, float& sMin, float& sMax) const {
+		int nDims = covDiag.size();
+		Eigen::MatrixXf M = previous.inverseW();
+		if (0 != W.size()) {
+			M = lowerW ? Eigen::MatrixXf(W.triangularView<Eigen::Lower>() * M) : Eigen::MatrixXf(W * M);
+		}
+		Eigen::MatrixXf gram = Eigen::MatrixXf::Zero(nDims, nDims);
+		gram.selfadjointView<Eigen::Lower>().rankUpdate(M.transpose());
+		Eigen::SelfAdjointEigenSolver<Eigen::MatrixXf> solver(gram, Eigen::EigenvaluesOnly);
+		sMax = std::sqrt(std::max(solver.eigenvalues().maxCoeff(), 0.0f));
+		sMin = std::sqrt(std::max(solver.eigenvalues().minCoeff(), 0.0f));
+	}
+
+	// rotation is empty before the first decomposition
+	void getParameters(Eigen::VectorXf& cov, Eigen::MatrixXf& rotation) const {
+		cov = covDiag;
+		rotation = trans;
+	}
+	void setParameters(const ConstVectorRef& cov, const ConstMatrixRef& rotation) {
+		if (0 == rotation.size()) {
+			covDiag = cov;
+			trans.resize(0, 0);
+			W.resize(0, 0);
+			lowerW = false;
+			return;
+		}
+		setDecomposition(cov, rotation);
+	}
+
+	Eigen::VectorXf covDiag;
+	Eigen::MatrixXf trans;
+	Eigen::MatrixXf W;		// whitening transform
+	bool lowerW = false;	// W is lower triangular (Cholesky)
+};
+
+const static int DEFAULT_METRIC_RANK = 32;
+
+/**
+ * covMat = trans' diag(leading) trans + residual (I - trans' trans), trans
+ * holds the r leading eigenvectors (r x d, orthonormal rows), so
+ *   |a - b|^2 = |x|^2 / residual + sum_i (trans x)_i^2 (1 / leading_i - 1 / residual)
+ * with x = a - b; the whitening transform W = I / sqrt(residual)
+ * + trans' diag(1 / sqrt(leading) - 1 / sqrt(residual)) trans is never formed
+ */
+struct LowRankMetric {
+	template <typename Storage, typename Acc>
+	using GaussianType = LowRankGaussian<Storage, Acc>;
+	static const CovType covType = COV_LOWRANK;
+
+	// before the first decomposition the metric is the Euclidean one (trans is empty)
+	explicit LowRankMetric(const int dimensions) {}
+
+	/**
+	 * spectrum: the r leading eigenvalues then the residual variance (r + 1)
+	 * rotation: the r leading eigenvectors, one per row (r x d)
+	 */
+	void setDecomposition(const ConstVectorRef& spectrum, const ConstMatrixRef& rotation) {
+		int rank = rotation.rows();
+		eigenValues = spectrum;
+		trans = rotation;
+		residualScale = 1.0f / std::sqrt(spectrum[rank]);
+		leadingScale = spectrum.head(rank).cwiseSqrt().cwiseInverse().array() - residualScale;
+		leadingWeight = spectrum.head(rank).cwiseInverse().array() - residualScale * residualScale;
+	}
+
+	template <typename V1, typename V2>
+	float distance(const Eigen::MatrixBase<V1>& v1, const Eigen::MatrixBase<V2>& v2) const {
+		if (0 == trans.size()) {
+			return (v1 - v2).norm();
+		}
+		Eigen::VectorXf diff = v1 - v2;
+		Eigen::VectorXf proj = trans * diff;
+		float squared = residualScale * residualScale * diff.squaredNorm()
+			+ proj.cwiseAbs2().dot(leadingWeight);
+		return std::sqrt(std::max(squared, 0.0f));
+	}
+
+	template <typename Derived>
+	Eigen::MatrixXf whiten(const Eigen::MatrixBase<Derived>& X) const {
+		Eigen::MatrixXf Xf = X.template cast<float>();
+		if (0 == trans.size()) {
+			return Xf;
+		}
+		Eigen::MatrixXf proj = leadingScale.asDiagonal() * (trans * Xf);
+		Xf *= residualScale;
+		Xf.noalias() += trans.transpose() * proj;
+		return Xf;
+	}
+
+	/**
+	 * bounds from the extreme singular values of W and of previous.W:
+	 * sigmaMin(W) / sigmaMax(W0) <= |W x| / |W0 x| <= sigmaMax(W) / sigmaMin(W0),
+	 * looser than the exact ones of FullMetric but O(r)
+	 */
+	void distortionFrom(const LowRankMetric& previous, float& sMin, float& sMax) const {
+		float lo, hi, lo0, hi0;
+		singularRange(lo, hi);
+		previous.singularRange(lo0, hi0);
+		sMin = lo / hi0;
+		sMax = hi / lo0;
+	}
+
+	// the singular values of W are 1 / sqrt(leading_i) and 1 / sqrt(residual)
+	void singularRange(float& sMin, float& sMax) const {
+		if (0 == trans.size()) {
+			sMin = sMax = 1.0f;
+			return;
+		}
+		sMin = sMax = residualScale;
+		if (leadingScale.size() > 0) {
+			sMin = std::min(sMin, leadingScale.minCoeff() + residualScale);
+			sMax = std::max(sMax, leadingScale.maxCoeff() + residualScale);
+		}
+	}
+
+	// both empty before the first decomposition
+	void getParameters(Eigen::VectorXf& cov, Eigen::MatrixXf& rotation) const {
+		cov = eigenValues;
+		rotation = trans;
+	}
+	void setParameters(const ConstVectorRef& cov, const ConstMatrixRef& rotation) {
+		if (0 == rotation.size()) {
+			eigenValues.resize(0);
+			trans.resize(0, 0);
+			return;
+		}
+		setDecomposition(cov, rotation);
+	}
+
+	Eigen::VectorXf eigenValues;	// r leading eigenvalues, then the residual variance
+	Eigen::MatrixXf trans;			// r x d
+	Eigen::VectorXf leadingScale;	// 1 / sqrt(leading) - 1 / sqrt(residual)
+	Eigen::VectorXf leadingWeight;	// 1 / leading - 1 / residual
+	float residualScale = 1.0f;		// 1 / sqrt(residual)
+};
+
+} /* namespace dml */
+
+#endif /* GAUSSIAN_METRICPOLICY_H_ */
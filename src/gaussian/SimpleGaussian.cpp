@@ -12,22 +12,23 @@
 
 namespace dml {
 
-class SimpleGaussian : public Gaussian {
+template <typename Storage = float, typename Acc = float>
+class SimpleGaussian final : public MetricGaussian<EuclideanMetric, Storage, Acc> {
 public:
+	typedef typename Gaussian<Storage, Acc>::ConstDataRef ConstDataRef;
+	typedef ComponentParts<Acc, typename Gaussian<Storage, Acc>::AccVector> Parts;
+
 	SimpleGaussian(int id, int size, int dimensions)
-		: Gaussian(id, size, dimensions) {}
+		: MetricGaussian<EuclideanMetric, Storage, Acc>(id, size, dimensions) {}
 
 	virtual ~SimpleGaussian(){}
 	
-	virtual void updateConstraintImpact(const ConstMatrixRef& X, 
+	virtual void updateConstraintImpact(const ConstDataRef& X,
 		const std::vector<int>& vAssign, const ConstraintPtr constraints) {}
-
-	virtual float applyDistance(const ConstVectorRef& v1, const ConstVectorRef& v2) {
-		return (v1 - v2).norm();
-	}
-
+	void updateConstraintImpact(const ConstDataRef& X, const std::vector<int>& vAssign,
+		const ConstraintPtr constraints, const Parts& parts) {}
 };
 
 } /* namespace dml */
 
-#endif /* GAUSSIAN_SIMPLEGAUSSIAN_ */	
\ No newline at end of file
+#endif /* GAUSSIAN_SIMPLEGAUSSIAN_ */	
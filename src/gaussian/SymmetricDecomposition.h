@@ -0,0 +1,90 @@
+/*
+ * SymmetricDecomposition.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Decomposition of a covariance matrix C (symmetric by construction) into the
+ * parameters of its Mahalanobis metric:
+ *   inverse(C) = trans' diag(1 / covDiag) trans
+ * Cholesky fast path when C is positive definite, C = L L' with
+ * L = L1 diag(l) (L1 unit lower): covDiag = l^2, trans = inverse(L1) is lower
+ * triangular, O(d^3 / 3).
+ * Otherwise (definiteness lost, e.g. by the cannot-link impact, or C too ill
+ * conditioned) SelfAdjointEigenSolver, C = U diag(lambda) U': the spectrum is
+ * shifted by a jitter so that its smallest value reaches the floor
+ * (DEFINITENESS_TOLERANCE x the largest), as adding jitter x I to C,
+ * covDiag = lambda + jitter, trans = U'.
+ * In both cases log(det(C)) = sum(log(covDiag)).
+ */
+
+#ifndef GAUSSIAN_SYMMETRICDECOMPOSITION_H_
+#define GAUSSIAN_SYMMETRICDECOMPOSITION_H_
+
+#include <algorithm>
+#include <cmath>
+
+#include "../utils/Eigen3.h"
+
+namespace dml {
+
+const static double DEFINITENESS_TOLERANCE = 1e-6;
+
+template <typename Scalar>
+class SymmetricDecomposition {
+public:
+	typedef Eigen::MatrixX<Scalar> Matrix;
+	typedef Eigen::VectorX<Scalar> Vector;
+
+	explicit SymmetricDecomposition(const Matrix& covMat) {
+		if (!decomposeCholesky(covMat)) {
+			decomposeEigen(covMat);
+		}
+	}
+
+	const Vector& getCovDiag() const { return covDiag; }
+	const Matrix& getTrans() const { return trans; }
+	// true when trans is lower triangular (Cholesky path)
+	bool isCholesky() const { return cholesky; }
+	// added to the diagonal of C by the repair, 0 when C was positive definite
+	Scalar getJitter() const { return jitter; }
+	Scalar logDet() const { return covDiag.array().log().sum(); }
+
+private:
+	bool decomposeCholesky(const Matrix& covMat) {
+		Eigen::LLT<Matrix> llt(covMat);
+		if (Eigen::Success != llt.info()) return false;
+		Vector pivots = llt.matrixLLT().diagonal();
+		Vector squared = pivots.cwiseAbs2();
+		if (!(squared.minCoeff() > Scalar(DEFINITENESS_TOLERANCE) * squared.maxCoeff())) return false;
+
+		// inverse(L1) = diag(l) inverse(L)
+		int nDims = covMat.rows();
+		trans = Matrix::Identity(nDims, nDims);
+		llt.matrixL().solveInPlace(trans);
+		trans = pivots.asDiagonal() * trans;
+		covDiag = squared;
+		cholesky = true;
+		return true;
+	}
+
+	void decomposeEigen(const Matrix& covMat) {
+		Eigen::SelfAdjointEigenSolver<Matrix> solver(covMat);
+		const Vector& values = solver.eigenvalues();		// increasing
+		Scalar largest = values.cwiseAbs().maxCoeff();
+		Scalar floor = Scalar(DEFINITENESS_TOLERANCE) * ((largest > 0) ? largest : Scalar(1));
+		jitter = std::max(Scalar(0), floor - values.minCoeff());
+		covDiag = values.array() + jitter;
+		trans = solver.eigenvectors().transpose();
+		cholesky = false;
+	}
+
+	Vector covDiag;
+	Matrix trans;
+	bool cholesky = false;
+	Scalar jitter = 0;
+};
+
+} /* namespace dml */
+
+#endif /* GAUSSIAN_SYMMETRICDECOMPOSITION_H_ */
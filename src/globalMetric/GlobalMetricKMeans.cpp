@@ -7,83 +7,316 @@
 
 #include "GlobalMetricKMeans.h"
 #include "../utils/functionUtils.h"
+#include "../constraint/ConstraintsCache.h"
 #include "../gaussian/SimpleGaussian.cpp"
 #include "../gaussian/DiagGaussian.cpp"
 #include "../gaussian/FullGaussian.cpp"
+#include "../gaussian/LowRankGaussian.cpp"
 
+#include <algorithm>
 #include <iostream>
-#include <cassert>
 #include <limits>
+#include <type_traits>
 
 namespace dml {
 
 using namespace Eigen;
 
-GlobalMetricKMeans::GlobalMetricKMeans(const ConstMatrixRef& dataset, const int numClts,
-	const std::string constraintFileName, const DistanceType distanceType)
-	:PCKMeans(dataset, numClts, constraintFileName, COV_NONE) {
-	distP2M = MatrixXf(nData, nClusters);
-
-	switch (distanceType) {
-		case DIST_EUCLIDEAN:
-			globalGaussian = GaussianPtr( new SimpleGaussian(GLOBAL_GAUSSIAN_ID, nData, nDims) );
-		break;
-		case DIST_MAHALANOBIS_DIAG:
-			globalGaussian = GaussianPtr( new DiagGaussian(GLOBAL_GAUSSIAN_ID, nData, nDims) );
-		break;
-		case DIST_MAHALANOBIS_FULL:
-			globalGaussian = GaussianPtr( new FullGaussian(GLOBAL_GAUSSIAN_ID, nData, nDims) );
-		break;
-		default:
-			assert(false && "Invalide distance type!");
-		break;
-	}
-	globalGaussian->setData(dataset);
+template <typename Metric, typename Storage, typename Acc>
+GlobalMetricKMeans<Metric, Storage, Acc>::GlobalMetricKMeans(const ConstDataRef& dataset, const int numClts,
+	const std::string constraintFileName)
+	:GlobalMetricKMeans(dataset, numClts,
+		ConstraintsCache::instance().get(constraintFileName)) {}
+
+template <typename Metric, typename Storage, typename Acc>
+GlobalMetricKMeans<Metric, Storage, Acc>::GlobalMetricKMeans(const ConstDataRef& dataset, const int numClts,
+	const ConstraintPtr constraints)
+	:Base(dataset, numClts, constraints, COV_NONE), boundMetric(dataset.rows()) {
+	globalGaussian = std::make_shared<GlobalGaussian>(GLOBAL_GAUSSIAN_ID, nData, nDims);
+	globalGaussian->addAllPoints(data);
+	vMetric.assign(nClusters, globalGaussian.get());
 }
 
-GlobalMetricKMeans::~GlobalMetricKMeans() {}
+template <typename Metric, typename Storage, typename Acc>
+GlobalMetricKMeans<Metric, Storage, Acc>::~GlobalMetricKMeans() {}
 
-/*virtual*/ void GlobalMetricKMeans::doVeryFirstClustering() {
+template <typename Metric, typename Storage, typename Acc>
+/*virtual*/ void GlobalMetricKMeans<Metric, Storage, Acc>::doVeryFirstClustering() {
 	// std::cout << "[trace]@ function : " <<  __PRETTY_FUNCTION__ << std::endl;
 	globalGaussian->updateMean();
-	globalGaussian->cacheDistPoint2Point(data);
-	cacheGlobalDistPoint2Mean();
+	globalGaussian->cacheConstraintDistances(data, constr);
+	cacheDistPoint2Mean();
 }
 
-/*virtual*/ float GlobalMetricKMeans::distanceByCluster(int idx1, int idx2, int cltId) {
-	return globalGaussian->distance(idx1, idx2);
+template <typename Metric, typename Storage, typename Acc>
+/*virtual*/ void GlobalMetricKMeans<Metric, Storage, Acc>::startMiniBatch() {
+	// the global gaussian holds all points, its statistics are centered on their mean
+	globalGaussian->updateMean();
+	Base::startMiniBatch();
 }
 
-/*virtual*/ float GlobalMetricKMeans::distanceToMeanOfCluster(int idx, int cltId) {
-	return distP2M(idx, cltId);
+template <typename Metric, typename Storage, typename Acc>
+/*virtual*/ void GlobalMetricKMeans<Metric, Storage, Acc>::resumeCaches() {
+	globalGaussian->updateMean();
+	Base::resumeCaches();
 }
 
-/*virtual*/ float GlobalMetricKMeans::maxDistanceByCluster(int cltId) {
-	return globalGaussian->getMaxDistance();
+template <typename Metric, typename Storage, typename Acc>
+/*virtual*/ void GlobalMetricKMeans<Metric, Storage, Acc>::findBestCluster(const std::vector<int>& randomIndex) {
+	if (usePruning()) {
+		findBestClusterPruned(randomIndex);
+	} else if (useCenterIndex()) {
+		float lowerOther = 0.0f;
+		for (int i = 0; i < nData; ++i) {
+			int idx = randomIndex[i];
+			reassign(idx, bestClusterByIndex(idx, lowerOther));
+		}
+	} else {
+		Base::findBestCluster(randomIndex);
+	}
 }
 
-/*virtual*/ float GlobalMetricKMeans::logDetByCluster(int cltId) {
-	return globalGaussian->getLogDet();
+template <typename Metric, typename Storage, typename Acc>
+bool GlobalMetricKMeans<Metric, Storage, Acc>::sequentialPairs() const {
+	// the bounds on the penalties hold for the sequential pass over the
+	// expanded pairs, and with non negative coefficients only
+	return nThreads <= 1 && !onlineUpdate
+		&& CONSTRAINT_PAIRS == constraintModel
+		&& constr->mlConst >= 0.0f && constr->clConst >= 0.0f;
 }
 
-/*virtual*/ void GlobalMetricKMeans::updateMixtures() {
+template <typename Metric, typename Storage, typename Acc>
+bool GlobalMetricKMeans<Metric, Storage, Acc>::usePruning() const {
+	return boundPruning && sequentialPairs();
+}
+
+template <typename Metric, typename Storage, typename Acc>
+bool GlobalMetricKMeans<Metric, Storage, Acc>::useCenterIndex() const {
+	return centerIndex && sequentialPairs();
+}
+
+template <typename Metric, typename Storage, typename Acc>
+void GlobalMetricKMeans<Metric, Storage, Acc>::findBestClusterPruned(const std::vector<int>& randomIndex) {
+	// the first pass has no bounds yet, distP2M is complete (or the index is)
+	bool haveBounds = boundsValid;
+	if (!haveBounds) {
+		upper.resize(nData);
+		lower.resize(nData);
+	}
+
+	for (int i = 0; i < nData; ++i) {
+		int idx = randomIndex[i];
+		int cltId = vAssign[idx];
+		if (haveBounds) {
+			float ownCost = upper[idx]
+				+ constr->mlConst * this->getMustLinksPenalty(idx, cltId)
+				+ constr->clConst * this->getCannotLinksPenalty(idx, cltId);
+			// strict: a tie is resolved by bestCluster, as without pruning
+			if (ownCost < lower[idx] + penaltyLowerBound(idx)) {
+				nDistSkipped += nClusters - 1;
+				continue;
+			}
+		}
+
+		if (useCenterIndex()) {
+			cltId = bestClusterByIndex(idx, lower[idx]);
+			reassign(idx, cltId);
+			upper[idx] = distP2M(idx, cltId);
+			continue;
+		}
+		if (haveBounds) {
+			const VectorXf& x = whitenedPoint(idx);
+			for (int k = 0; k < nClusters; ++k) {
+				if (k != cltId) distP2M(idx, k) = (x - centersW.col(k)).norm();
+			}
+			nDistEvaluated += nClusters - 1;
+		}
+		cltId = this->bestCluster(idx);
+		reassign(idx, cltId);
+		upper[idx] = distP2M(idx, cltId);
+		lower[idx] = std::numeric_limits<float>::max();
+		for (int k = 0; k < nClusters; ++k) {
+			if (k != cltId) lower[idx] = std::min(lower[idx], distP2M(idx, k));
+		}
+	}
+	boundsValid = true;
+}
+
+template <typename Metric, typename Storage, typename Acc>
+float GlobalMetricKMeans<Metric, Storage, Acc>::penaltyLowerBound(const int idx) {
+	// in another cluster, every ML to the own cluster is violated
+	int cltId = vAssign[idx];
+	float mlPenalty = 0.0f;
+	ConstraintAdjacency::Range mustLinks = constr->ML.neighbors(idx);
+	for (int k = 0; k < mustLinks.size(); ++k) {
+		if (vAssign[mustLinks.first[k]] == cltId) {
+			mlPenalty += mlDistanceByCluster(mustLinks.offset + k, cltId);
+		}
+	}
+	return constr->mlConst * mlPenalty + clPenaltyFloor(idx);
+}
+
+template <typename Metric, typename Storage, typename Acc>
+float GlobalMetricKMeans<Metric, Storage, Acc>::clPenaltyFloor(const int idx) {
+	// a CL costs maxDist - dist >= 0 (maxDist bounds the diameter), min(0, .)
+	// only guards against the rounding of the cached distances
+	float clPenalty = 0.0f;
+	ConstraintAdjacency::Range cannotLinks = constr->CL.neighbors(idx);
+	if (!cannotLinks.empty()) {
+		int cltId = vAssign[idx];
+		float maxDistance = maxDistanceByCluster(cltId);
+		for (int k = 0; k < cannotLinks.size(); ++k) {
+			clPenalty += std::min(0.0f, maxDistance - clDistanceByCluster(cannotLinks.offset + k, cltId));
+		}
+	}
+	return constr->clConst * clPenalty;
+}
+
+template <typename Metric, typename Storage, typename Acc>
+int GlobalMetricKMeans<Metric, Storage, Acc>::bestClusterByIndex(const int idx, float& lowerOther) {
+	const VectorXf& x = whitenedPoint(idx);
+	int ownClt = vAssign[idx];
+	auto costOf = [&](const int cltId, const float dist) {
+		return dist - this->logDetByCluster(cltId)
+			+ constr->mlConst * this->getMustLinksPenalty(idx, cltId)
+			+ constr->clConst * this->getCannotLinksPenalty(idx, cltId);
+	};
+
+	int nEvaluated = 1;
+	float nearestDist = 0.0f;
+	int nearestClt = meanIndex.nearest(x, nearestDist, nEvaluated);
+	float bestCost = std::min(costOf(nearestClt, nearestDist),
+		costOf(ownClt, (x - centersW.col(ownClt)).norm()));
+
+	// the slack keeps the means of cost bestCost in the radius despite rounding
+	float radius = bestCost + this->logDetByCluster(ownClt) - clPenaltyFloor(idx);
+	radius += 1e-4f * std::abs(radius) + 1e-6f;
+	meanIndex.withinRadius(x, radius, candidates, nEvaluated);
+	std::sort(candidates.begin(), candidates.end());
+
+	// the scan of bestCluster, on the candidates only
+	float minCost = std::numeric_limits<float>::max();
+	int minIndex = ownClt;
+	for (const auto& candidate : candidates) {
+		float cost = costOf(candidate.first, candidate.second);
+		if (cost < minCost) {
+			minCost = cost;
+			minIndex = candidate.first;
+		}
+	}
+	lowerOther = radius;
+	for (const auto& candidate : candidates) {
+		if (candidate.first != minIndex) lowerOther = std::min(lowerOther, candidate.second);
+		distP2M(idx, candidate.first) = candidate.second;
+	}
+
+	nDistEvaluated += nEvaluated;
+	nDistSkipped += std::max(0, nClusters - nEvaluated);
+	return minIndex;
+}
+
+template <typename Metric, typename Storage, typename Acc>
+const VectorXf& GlobalMetricKMeans<Metric, Storage, Acc>::whitenedPoint(const int idx) {
+	if (Xw.cols() == nData) {
+		pointW = Xw.col(idx);
+	} else {
+		pointW = globalGaussian->getMetric().whiten(data.col(idx));
+	}
+	return pointW;
+}
+
+template <typename Metric, typename Storage, typename Acc>
+/*virtual*/ void GlobalMetricKMeans<Metric, Storage, Acc>::updateMixtures() {
 	for (int cltId = 0; cltId < nClusters; ++cltId) {
 		vMixture.at(cltId)->updateMean();
 	}
 	globalGaussian->updateMean();
 	globalGaussian->updateConstraintImpact(data, vAssign, constr);
-	globalGaussian->cacheDistPoint2Point(data);
-	cacheGlobalDistPoint2Mean();
+	globalGaussian->cacheConstraintDistances(data, constr);
+	cacheDistPoint2Mean();
 }
 
-void GlobalMetricKMeans::cacheGlobalDistPoint2Mean() {
-	distP2M.setZero();
+template <typename Metric, typename Storage, typename Acc>
+/*virtual*/ void GlobalMetricKMeans<Metric, Storage, Acc>::cacheDistPoint2Mean() {
+	MatrixXf means(nDims, nClusters);
 	for (int cltId = 0; cltId < nClusters; ++cltId) {
-		VectorXf mean = vMixture.at(cltId)->getMean();
+		means.col(cltId) = vMixture.at(cltId)->getMean().template cast<float>();
+	}
+	// the metric is shared by all clusters: whiten once, then one matrix product
+	const Metric& metric = globalGaussian->getMetric();
+	MatrixXf meansW = metric.whiten(means);
+	distP2M.resize(nData, nClusters);
+	// the points are whitened by blocks; only the bounds and the index read
+	// them again in the E-step, from Xw with float storage, whitened one at a
+	// time with half storage (a float copy would double the data set)
+	bool keepWhitened = (usePruning() || useCenterIndex())
+		&& !std::is_same<Storage, Eigen::half>::value;
+	Xw.resize(keepWhitened ? nDims : 0, keepWhitened ? nData : 0);
+	// with the bounds or the index, the E-step evaluates the distances it
+	// needs and the objective only reads the one to the own mean
+	bool ownOnly = (usePruning() && boundsValid) || useCenterIndex();
+	for (int first = 0; first < nData; first += WHITEN_BLOCK_SIZE) {
+		int nCols = std::min(WHITEN_BLOCK_SIZE, nData - first);
+		MatrixXf blockW = metric.whiten(data.middleCols(first, nCols));
+		if (!ownOnly) {
+			pointToMeanDistances(blockW, squaredColumnNorms(blockW), meansW, distP2M.middleRows(first, nCols));
+		} else {
+			for (int col = 0; col < nCols; ++col) {
+				int cltId = vAssign[first + col];
+				distP2M(first + col, cltId) = (blockW.col(col) - meansW.col(cltId)).norm();
+			}
+		}
+		if (keepWhitened) Xw.middleCols(first, nCols) = blockW;
+	}
+	nDistEvaluated += ownOnly ? (double) nData : (double) nData * nClusters;
+	if (!usePruning() && !useCenterIndex()) return;
+
+	if (usePruning() && boundsValid) {
+		// a mean moved by drift[k] (in the new metric) and the distances
+		// shrank by at most sMin with the metric: lower[i] stays a lower bound
+		// of the distance to the other means, upper[i] is the exact own one
+		float sMin = 1.0f, sMax = 1.0f;
+		metric.distortionFrom(boundMetric, sMin, sMax);
+		VectorXf drift = (meansW - metric.whiten(boundCenters)).colwise().norm().transpose();
+		int fastest = 0;
+		float maxDrift = drift.maxCoeff(&fastest);
+		float secondDrift = 0.0f;
+		for (int cltId = 0; cltId < nClusters; ++cltId) {
+			if (cltId != fastest) secondDrift = std::max(secondDrift, drift[cltId]);
+		}
 		for (int idx = 0; idx < nData; ++idx) {
-			distP2M(idx, cltId) = globalGaussian->applyDistance(data.col(idx), mean);
+			int cltId = vAssign[idx];
+			upper[idx] = distP2M(idx, cltId);
+			lower[idx] = sMin * lower[idx] - ((cltId == fastest) ? secondDrift : maxDrift);
 		}
 	}
+	if (useCenterIndex()) {
+		meanIndex.build(meansW);
+	}
+	centersW = meansW;
+	boundCenters = means;
+	boundMetric = metric;
 }
 
+template <typename Metric, typename Storage, typename Acc>
+/*virtual*/ EMResult GlobalMetricKMeans<Metric, Storage, Acc>::getResult() {
+	EMResult result = Base::getResult();
+	result.nDistEvaluated = nDistEvaluated;
+	result.nDistSkipped = nDistSkipped;
+	return result;
+}
+
+template class GlobalMetricKMeans<EuclideanMetric, float, float>;
+template class GlobalMetricKMeans<EuclideanMetric, float, double>;
+template class GlobalMetricKMeans<EuclideanMetric, Eigen::half, float>;
+template class GlobalMetricKMeans<DiagonalMetric, float, float>;
+template class GlobalMetricKMeans<DiagonalMetric, float, double>;
+template class GlobalMetricKMeans<DiagonalMetric, Eigen::half, float>;
+template class GlobalMetricKMeans<FullMetric, float, float>;
+template class GlobalMetricKMeans<FullMetric, float, double>;
+template class GlobalMetricKMeans<FullMetric, Eigen::half, float>;
+template class GlobalMetricKMeans<LowRankMetric, float, float>;
+template class GlobalMetricKMeans<LowRankMetric, float, double>;
+template class GlobalMetricKMeans<LowRankMetric, Eigen::half, float>;
+
 } /* namespace dml */
@@ -10,37 +10,121 @@
 
 #include "../utils/Eigen3.h"
 #include "../pckmeans/PCKMeans.h"
+#include "../gaussian/CenterIndex.h"
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace dml {
 
-enum DistanceType {
-	DIST_EUCLIDEAN, DIST_MAHALANOBIS_DIAG, DIST_MAHALANOBIS_FULL
-};
-
-class GlobalMetricKMeans : public PCKMeans {
+/**
+ * one metric shared by all clusters: EuclideanMetric (PCKMeans without metric
+ * learning), DiagonalMetric, FullMetric or LowRankMetric
+ */
+template <typename Metric, typename Storage = float, typename Acc = float>
+class GlobalMetricKMeans : public PCKMeans<Storage, Acc> {
 public:
-	GlobalMetricKMeans(const ConstMatrixRef& dataset, const int numClts, 
-		const std::string constraintFileName, const DistanceType type = DIST_EUCLIDEAN);
+	typedef PCKMeans<Storage, Acc> Base;
+	typedef typename Metric::template GaussianType<Storage, Acc> GlobalGaussian;
+	typedef typename Base::ConstDataRef ConstDataRef;
+
+	GlobalMetricKMeans(const ConstDataRef& dataset, const int numClts,
+		const std::string constraintFileName);
+	GlobalMetricKMeans(const ConstDataRef& dataset, const int numClts,
+		const ConstraintPtr constraints);
 	virtual ~GlobalMetricKMeans();
 
 	virtual void doVeryFirstClustering();
+	virtual void findBestCluster(const std::vector<int>& randomIndex);
 	virtual void updateMixtures();
+	virtual EMResult getResult();
 
 protected:
-	virtual float distanceByCluster(int idx1, int idx2, int cltId = -1);
-	virtual float distanceToMeanOfCluster(int idx, int cltId = -1);
-	virtual float maxDistanceByCluster(int cltId = -1);
-	virtual float logDetByCluster(int cltId = -1);
+	virtual void cacheDistPoint2Mean();
+	virtual void startMiniBatch();
+	virtual void resumeCaches();
 
-private:
-	void cacheGlobalDistPoint2Mean();
+	/**
+	 * Hamerly pruning: upper[i] bounds the distance of point i to the mean of
+	 * its cluster, lower[i] the distance to any other mean. A point keeps its
+	 * cluster without evaluating the others when
+	 *   upper[i] + penalty(i, own) <= lower[i] + lower bound of the penalties
+	 * After each M-step the bounds follow the drift of the means and the
+	 * distortion of the metric (see distortionFrom).
+	 */
+	bool usePruning() const;
+	void findBestClusterPruned(const std::vector<int>& randomIndex);
+	// lower bound of the penalties of idx in any cluster other than its own
+	float penaltyLowerBound(const int idx);
+	// lower bound of the CL penalty of idx in any cluster
+	float clPenaltyFloor(const int idx);
+
+	/**
+	 * k-d tree search: the nearest mean and the own one bound the best cost,
+	 * a mean can only reach it within bound + logDet - clPenaltyFloor, so the
+	 * exact costs of the means in that radius give the same winner as the
+	 * scan over all K. lowerOther: lower bound of the distance to the means
+	 * other than the winner, for the pruning bounds.
+	 */
+	bool useCenterIndex() const;
+	int bestClusterByIndex(const int idx, float& lowerOther);
 
-	Eigen::MatrixXf distP2M;
+	// sequential pass over the expanded pairs with non negative coefficients
+	bool sequentialPairs() const;
 
-	GaussianPtr globalGaussian;
+	// the whitened point idx, from Xw when it is kept
+	const Eigen::VectorXf& whitenedPoint(const int idx);
+
+	using Base::nData;
+	using Base::nDims;
+	using Base::nClusters;
+	using Base::data;
+	using Base::vAssign;
+	using Base::vMixture;
+	using Base::constr;
+	using Base::vMetric;
+	using Base::distP2M;
+	using Base::nThreads;
+	using Base::onlineUpdate;
+	using Base::constraintModel;
+	using Base::boundPruning;
+	using Base::centerIndex;
+	using Base::reassign;
+	using Base::mlDistanceByCluster;
+	using Base::clDistanceByCluster;
+	using Base::maxDistanceByCluster;
+
+private:
+	std::shared_ptr<GlobalGaussian> globalGaussian;
+
+	Eigen::MatrixXf Xw;				// whitened points, only kept for the bounds and the index (float storage)
+	Eigen::VectorXf pointW;			// see whitenedPoint
+	Eigen::MatrixXf centersW;		// whitened means
+	Eigen::MatrixXf boundCenters;	// means when the bounds were last updated
+	Metric boundMetric;				// metric when the bounds were last updated
+	Eigen::VectorXf upper;
+	Eigen::VectorXf lower;
+	bool boundsValid = false;
+	CenterIndex meanIndex;			// k-d tree over centersW
+	std::vector<std::pair<int, float> > candidates;
+	double nDistEvaluated = 0;
+	double nDistSkipped = 0;
 };
 
+extern template class GlobalMetricKMeans<EuclideanMetric, float, float>;
+extern template class GlobalMetricKMeans<EuclideanMetric, float, double>;
+extern template class GlobalMetricKMeans<EuclideanMetric, Eigen::half, float>;
+extern template class GlobalMetricKMeans<DiagonalMetric, float, float>;
+extern template class GlobalMetricKMeans<DiagonalMetric, float, double>;
+extern template class GlobalMetricKMeans<DiagonalMetric, Eigen::half, float>;
+extern template class GlobalMetricKMeans<FullMetric, float, float>;
+extern template class GlobalMetricKMeans<FullMetric, float, double>;
+extern template class GlobalMetricKMeans<FullMetric, Eigen::half, float>;
+extern template class GlobalMetricKMeans<LowRankMetric, float, float>;
+extern template class GlobalMetricKMeans<LowRankMetric, float, double>;
+extern template class GlobalMetricKMeans<LowRankMetric, Eigen::half, float>;
+
 } /* namespace dml */
 
-#endif /* GLOBAL_METRIC_KMEANS_H_ */	
\ No newline at end of file
+#endif /* GLOBAL_METRIC_KMEANS_H_ */
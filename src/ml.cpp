@@ -37,14 +37,22 @@
 #include <memory>
 #include <cmath>
 #include <chrono>
+#include <mutex>
+#include <functional>
+#include <map>
+#include <sstream>
 
 #include "utils/propertyutil.h"
 #include "utils/dataUtils.h"
 #include "utils/functionUtils.h"
 #include "utils/testUtils.h"
+#include "utils/selfTests.h"
+#include "utils/parallelUtils.h"
+#include "utils/requestServer.h"
 
 #include "emkmeans/EMResult.h"
 #include "emkmeans/EMKMeans.h"
+#include "constraint/ConstraintsCache.h"
 #include "pckmeans/PCKMeans.h"
 #include "mpckmeans/MPCKMeans.h"
 #include "globalMetric/GlobalMetricKMeans.h"
@@ -59,11 +67,94 @@ std::vector<std::string> getListOfConstraintFile(
         std::string listFileName, std::string dataDir);
 
 /**
- * run experiment with one algorithm and one constraints file
+ * options of one run, read from the params file
  */
-dml::EMResult executeAlgo(std::string algoName, std::string constraintFileName,
-        const MatrixXf& inputData, int nClusters, int maxIter, float minObjChange,
-        std::vector<int>& vAssign);
+struct RunOptions {
+    int nThreads = 1;           // numberThreadsPerRun
+    bool onlineUpdate = false;  // onlineUpdate
+    dml::DiameterMethod diameterMethod = dml::DIAMETER_EXACT; // diameterEstimator
+    dml::ConstraintModel constraintModel = dml::CONSTRAINT_PAIRS; // constraintModel
+    bool boundPruning = false;  // boundPruning
+    bool centerIndex = false;   // centerIndex
+    int miniBatchSize = 0;      // miniBatchSize
+    bool warmStart = false;     // warmStart
+    std::string checkpointDir;  // checkpointDir, empty = no checkpoint
+    int checkpointEvery = 0;    // checkpointEvery
+    bool resumeCheckpoints = false; // resumeFromCheckpoints
+    int metricRank = dml::DEFAULT_METRIC_RANK; // metricRank
+};
+
+/**
+ * one run: the algorithm, its params and its constraints
+ */
+struct RunRequest {
+    std::string algoName;
+    int nClusters = 0;
+    int maxIter = 0;
+    float minObjChange = 0.0f;
+    std::string constraintName;         // the constraint file, or a label
+    dml::ConstraintPtr constraints;
+    std::string checkpointName;         // file the run is checkpointed into
+                                        // (and resumed from), or empty
+    unsigned seed = 0;                  // seed of the random engine of the run
+};
+
+/**
+ * run experiment with one algorithm and one constraints set
+ * state: nullptr, or the solution of the previous run in the chain (empty
+ * for the first one), replaced by the solution of this run
+ */
+template <typename Storage, typename Acc>
+dml::EMResult executeAlgo(const RunRequest& request,
+        const Ref<const MatrixX<Storage> >& inputData, const RunOptions& options,
+        std::vector<int>& vAssign, dml::ClusteringState* state);
+
+/**
+ * executeAlgo bound to the scalar types chosen by the precision param:
+ * "float" (float storage and accumulation), "double" (float storage, double
+ * accumulation) or "half" (half storage, float accumulation)
+ */
+typedef std::function<dml::EMResult(const RunRequest&, std::vector<int>&,
+        dml::ClusteringState*)> AlgoRunner;
+/**
+ * the runner owns the mean-normalized data set in its storage scalar, the
+ * loaded dataset is released: half mode never holds a float copy of it
+ */
+AlgoRunner makeAlgoRunner(const std::string precision, dml::DataMatrix dataset,
+        const RunOptions& options);
+
+/**
+ * resident mode: the data set stays loaded and each request runs one
+ * clustering (framing: see utils/requestServer.h), one "key values" per line:
+ *   session <name>                     the warm state is kept per session,
+ *                                      the least recently used of more than
+ *                                      MAX_SESSIONS sessions is dropped
+ *   algo, numberClusters, maxIteration, minObjectiveFunctionChange
+ *                                      default to the properties file,
+ *                                      1 <= numberClusters <= nData and
+ *                                      maxIteration > 0
+ *   constraintFile <name>              under dataDir, parsed once and cached
+ *   ml <idx1> <idx2>, cl <idx1> <idx2> inline constraints instead
+ *   warmStart <0|1>                    start from the last solution of the
+ *                                      session (default 1)
+ * response: "ok <nData>", the assignment on one line, the EMResult json;
+ * or "error <message>"
+ * socketPath: empty = requests on stdin, responses on out
+ */
+void serveClustering(const RunRequest& defaults, const std::string& dataDir,
+        AlgoRunner runAlgo, int nData, const std::vector<int>& vGroundTruthLabel,
+        int nClasses, const std::string& socketPath, std::ostream& out);
+
+/**
+ * print parse throughput of a text file, nothing for mmap-ed binary files
+ */
+void printLoadStats(const std::string fileName, const dml::LoadStats& stats);
+
+/**
+ * relative cost of one constraint file (its size), used to schedule long jobs
+ * first; the algorithm is the same for every job of a sweep
+ */
+float estimateConstraintFileCost(const std::string constraintFileName);
 
 /**
  * calculate averge result of all repeats of one experimentation
@@ -99,31 +190,153 @@ int main(int argc, char* argv[]) {
         propertyFile = std::string(argv[1]);
     }
 
+    // resident mode, requests on stdin (the logs go to stderr) or on a socket:
+    // ml --serve <propertiesFile> [socketPath]
+    bool serve = (argc >= 3 && 0 == std::string(argv[1]).compare("--serve"));
+    std::string socketPath = (argc >= 4) ? std::string(argv[3]) : "";
+    std::ostream responseOut(std::cout.rdbuf());
+    if (serve) {
+        propertyFile = std::string(argv[2]);
+        if (socketPath.empty()) {
+            std::cout.rdbuf(std::cerr.rdbuf());
+        }
+    }
+
+    // convert a dataset (text .mat or .npy) to the binary dataset format:
+    // ml --convert <inputFile> <outputFile>
+    if (4 == argc && 0 == std::string(argv[1]).compare("--convert")) {
+        dml::DataMatrix dataset = loadDataMatrix(argv[2]);
+        dml::writeMatrixFile(argv[3], dataset.matrix());
+        std::cout << "Converted " << argv[2] << " (" << dataset.matrix().rows()
+            << " x " << dataset.matrix().cols() << ") to " << argv[3] << std::endl;
+        return 0;
+    }
+
+    // cost of one distance through the virtual Gaussian API and the metric policies:
+    // ml --bench-distance <dataFile> [nPairs]
+    if (argc >= 3 && 0 == std::string(argv[1]).compare("--bench-distance")) {
+        dml::DataMatrix dataset = loadDataMatrix(argv[2]);
+        benchmarkDistanceDispatch(dataset.matrix(), (4 == argc) ? std::atoi(argv[3]) : 1000000);
+        return 0;
+    }
+
+    // cost of the covariance decompositions across the dimension:
+    // ml --bench-decomposition [maxDimensions]
+    if (argc >= 2 && 0 == std::string(argv[1]).compare("--bench-decomposition")) {
+        benchmarkCovDecomposition((3 == argc) ? std::atoi(argv[2]) : 400);
+        return 0;
+    }
+
+    // the ML / CL component formulas against the explicit pairwise sums:
+    // ml --test-components
+    if (2 == argc && 0 == std::string(argv[1]).compare("--test-components")) {
+        double errorDouble = testComponentMoments<double>();
+        float errorFloat = testComponentMoments<float>();
+        bool passed = (errorDouble < 1e-9) && (errorFloat < 1e-3f);
+        std::cout << "Component moments: relative error " << errorDouble << " (double), "
+            << errorFloat << " (float)\t" << (passed ? "PASSED" : "FAILED") << std::endl;
+        return passed ? 0 : 1;
+    }
+
+    // the online update of the local diagonal metrics against a recomputation
+    // from the assignment after each move: ml --test-online
+    if (2 == argc && 0 == std::string(argv[1]).compare("--test-online")) {
+        double error = testOnlineStatistics<double>();
+        bool passed = (error < 1e-6);
+        std::cout << "Online statistics: relative error " << error << "\t"
+            << (passed ? "PASSED" : "FAILED") << std::endl;
+        return passed ? 0 : 1;
+    }
+
+    // every algorithm and the errors of the C API: ml --test-api
+    if (2 == argc && 0 == std::string(argv[1]).compare("--test-api")) {
+        int nFailed = testClusterApi();
+        std::cout << "C API\t" << (0 == nFailed ? "PASSED" : "FAILED") << std::endl;
+        return (0 == nFailed) ? 0 : 1;
+    }
+
+    // the assignments with the bound pruning and the center index against the
+    // exhaustive E-step, for each metric: ml --test-pruning
+    if (2 == argc && 0 == std::string(argv[1]).compare("--test-pruning")) {
+        int nDiffer = testPrunedAssignments();
+        std::cout << "Pruned assignments\t" << (0 == nDiffer ? "PASSED" : "FAILED") << std::endl;
+        return (0 == nDiffer) ? 0 : 1;
+    }
+
     std::cout << "Using properties file: " << propertyFile << std::endl;
     prop.read(propertyFile.c_str(), params);
 
     std::cout << "Detected params: \n";
 	prop.print(std::cout, params);
 
-    // read input matrix
+    // read input matrix, binary datasets are mapped in memory without copy
 	std::string inputFile = params["dataDir"] + params["inputDataFile"];
-	MatrixXf X = readMatrix(inputFile);
+	dml::LoadStats loadStats;
+	dml::DataMatrix dataset = loadDataMatrix(inputFile, &loadStats);
+	dml::DataMatrix::MapType X = dataset.matrix();
 	std::cout << "Inputdata nExamples = " << X.cols()
 		<< ", dimensions = " << X.rows() << std::endl;
-
-    // mean-normalize input data (subtract mean from each column of X)
-    MatrixXf X_aligned = X.colwise() - X.rowwise().mean();
+	printLoadStats(inputFile, loadStats);
+    int nData = (int) X.cols();
 
     // read ground truth
     int nClasses = 0;
     std::string groundTruthFile = params["dataDir"] + params["groundTruthFile"];
-    std::vector<int> vGroundTruthLabel = readGroundTruth(groundTruthFile, nClasses);
+    std::vector<int> vGroundTruthLabel = readGroundTruth(groundTruthFile, nClasses, &loadStats);
+    printLoadStats(groundTruthFile, loadStats);
 
     // read algorithm params
     std::string algoName = params["algo"];
     int maxIter = std::stoi(params["maxIteration"]);
     float minObjChange = std::stof(params["minObjectiveFunctionChange"]);
     int nClusters = std::stoi(params["numberClusters"]);
+    std::string precision = params.count("precision") ? params["precision"] : "float";
+    RunOptions runOptions;
+    if (params.count("numberThreadsPerRun")) runOptions.nThreads = stoi(params["numberThreadsPerRun"]);
+    if (params.count("onlineUpdate")) runOptions.onlineUpdate = (0 != stoi(params["onlineUpdate"]));
+    if (params.count("boundPruning")) runOptions.boundPruning = (0 != stoi(params["boundPruning"]));
+    if (params.count("centerIndex")) runOptions.centerIndex = (0 != stoi(params["centerIndex"]));
+    if (params.count("miniBatchSize")) runOptions.miniBatchSize = stoi(params["miniBatchSize"]);
+    if (params.count("metricRank")) runOptions.metricRank = stoi(params["metricRank"]);
+    if (params.count("warmStart")) runOptions.warmStart = (0 != stoi(params["warmStart"]));
+    if (params.count("checkpointDir")) runOptions.checkpointDir = params["checkpointDir"];
+    if (params.count("checkpointEvery")) runOptions.checkpointEvery = stoi(params["checkpointEvery"]);
+    if (params.count("resumeFromCheckpoints")) {
+        runOptions.resumeCheckpoints = (0 != stoi(params["resumeFromCheckpoints"]));
+    }
+    if (runOptions.resumeCheckpoints && runOptions.miniBatchSize > 0) {
+        throw std::runtime_error("resumeFromCheckpoints needs the full batch EM (miniBatchSize = 0)");
+    }
+    if (params.count("diameterEstimator")) {
+        if (0 == params["diameterEstimator"].compare("sweep")) {
+            runOptions.diameterMethod = dml::DIAMETER_SWEEP;
+        } else if (0 != params["diameterEstimator"].compare("exact")) {
+            throw std::runtime_error("Can not detect diameter estimator " + params["diameterEstimator"]);
+        }
+    }
+    if (params.count("constraintModel")) {
+        if (0 == params["constraintModel"].compare("components")) {
+            runOptions.constraintModel = dml::CONSTRAINT_COMPONENTS;
+        } else if (0 != params["constraintModel"].compare("pairs")) {
+            throw std::runtime_error("Can not detect constraint model " + params["constraintModel"]);
+        }
+    }
+    // the resident mode runs one request at a time
+    int nWorkers = params.count("numberWorkers") ? stoi(params["numberWorkers"]) : 0;
+    dml::configureEigenThreads(serve ? 1 : nWorkers, runOptions.nThreads);
+
+    AlgoRunner runAlgo = makeAlgoRunner(precision, std::move(dataset), runOptions);
+    RunRequest defaults;
+    defaults.algoName = algoName;
+    defaults.nClusters = nClusters;
+    defaults.maxIter = maxIter;
+    defaults.minObjChange = minObjChange;
+
+    if (serve) {
+        serveClustering(defaults, params["dataDir"], runAlgo, nData,
+            vGroundTruthLabel, nClasses, socketPath, responseOut);
+        return 0;
+    }
 
     // get list constraints file
     std::string listConstraintFileName = params["listOfConstraintFile"];
@@ -133,44 +346,119 @@ int main(int argc, char* argv[]) {
 
     // prepare experimentation
     int nRepeatTimes = stoi(params["repeatTimes"]);
-    // std::vector<dml::EMResult> resultOfAllExperiments;
-    float progressCount = 0;
+    std::string resultFullName = params["resultDir"] + params["resultFile"];
 
     // create algorithm, and execute
     // for each experiment (each constraint file),
     // 		execute the algo k times separately and get the avg result
+    // every (constraint file, repeat) is an independent job sharing the data set
+    // and the ground truth read-only, results are stored by (file, repeat)
+    // so the averages are the same as running them one after another
+    int nFiles = (int) vFiles.size();
+    std::vector<std::vector<dml::EMResult> > allRuns(nFiles,
+        std::vector<dml::EMResult>(nRepeatTimes));
+    std::vector<int> nRunsLeft(nFiles, nRepeatTimes);
+    int nextFileToWrite = 0;
+    std::mutex progressLock;
+
+    // the seeds are drawn here, the workers never read std::rand
+    std::vector<std::vector<unsigned> > runSeeds(nFiles, std::vector<unsigned>(nRepeatTimes));
+    for (auto& fileSeeds : runSeeds) {
+        for (auto& seed : fileSeeds) {
+            seed = (unsigned) std::rand();
+        }
+    }
+
+    // write the averages in the order of vFiles, as soon as a prefix is done
+    auto onRunDone = [&](int fileIdx) {
+        std::lock_guard<std::mutex> guard(progressLock);
+        nRunsLeft[fileIdx]--;
+        while (nextFileToWrite < nFiles && 0 == nRunsLeft[nextFileToWrite]) {
+            std::vector <dml::EMResult> oneExperiment;
+            for (const auto& result : allRuns[nextFileToWrite]) {
+                if (-1 == result.reachLocalMinimal) {continue;}
+                oneExperiment.push_back(result);
+            }
+            dml::EMResult avgResult;
+            if (oneExperiment.size() > 0) {
+                avgResult = calculateAvgResult(oneExperiment);
+            } else {
+                avgResult.reachLocalMinimal = -1;//case error
+            }
+            appendResult(avgResult, resultFullName);
+            nextFileToWrite++;
+            std::cout << "Progress: " << (100.0 * nextFileToWrite / nFiles) << std::endl;
+        }
+    };
+
     using namespace std::chrono;
-    for (const auto& constraintFileName : vFiles) {
-        std::vector <dml::EMResult> oneExperiment;
-        for (int nRun = 0; nRun < nRepeatTimes; ++nRun) {
-            std::vector<int> vAssign;
-            
-            high_resolution_clock::time_point t1 = high_resolution_clock::now();
-            dml::EMResult result = executeAlgo(algoName, constraintFileName,
-			    X_aligned, nClusters, maxIter, minObjChange, vAssign);
-            high_resolution_clock::time_point t2 = high_resolution_clock::now();
-            if (-1 == result.reachLocalMinimal) {continue;}
+    dml::WorkStealingScheduler scheduler(nWorkers);
+    auto runOnce = [&](int fileIdx, int nRun, dml::ClusteringState* state) {
+        std::vector<int> vAssign;
+        RunRequest request = defaults;
+        request.constraintName = vFiles[fileIdx];
+        request.seed = runSeeds[fileIdx][nRun];
+        try {
+            request.constraints = dml::ConstraintsCache::instance().get(vFiles[fileIdx]);
+        } catch (const std::exception& e) {
+            // a missing or corrupt file fails its own runs, not the sweep
+            std::cout << "Skip " << vFiles[fileIdx] << ": " << e.what() << '\n';
+            allRuns[fileIdx][nRun].reachLocalMinimal = -1;//case error
+            if (state) {
+                *state = dml::ClusteringState();
+            }
+            onRunDone(fileIdx);
+            return;
+        }
+        // one checkpoint per (algorithm, constraint file, repeat)
+        if (!runOptions.checkpointDir.empty() && runOptions.checkpointEvery > 0) {
+            std::string constraintName = vFiles[fileIdx].substr(vFiles[fileIdx].find_last_of('/') + 1);
+            request.checkpointName = runOptions.checkpointDir + algoName + "_" + constraintName
+                + "_" + std::to_string(nRun) + ".ckpt";
+        }
 
+        high_resolution_clock::time_point t1 = high_resolution_clock::now();
+        dml::EMResult result = runAlgo(request, vAssign, state);
+        high_resolution_clock::time_point t2 = high_resolution_clock::now();
+        if (-1 != result.reachLocalMinimal) {
             auto duration = std::chrono::duration_cast<std::chrono::milliseconds>( t2 - t1 ).count();
             result.duration = (float)duration;
             result.vMeasure = VMeasure(vAssign, vGroundTruthLabel, nClasses, nClusters);
-		    
-            oneExperiment.push_back(result);
+        } else if (state) {
+            *state = dml::ClusteringState();    // the next run of the chain starts cold
         }
-        dml::EMResult avgResult;
-        if (oneExperiment.size() > 0) {
-            avgResult = calculateAvgResult(oneExperiment);   
-        } else {
-            avgResult.reachLocalMinimal = -1;//case error
+        allRuns[fileIdx][nRun] = result;
+        onRunDone(fileIdx);
+    };
+    if (runOptions.warmStart) {
+        // one chain per repeat: each file is seeded by the solution of the
+        // previous file of the list, the files of one chain run in order
+        float chainCost = 0.0f;
+        for (int fileIdx = 0; fileIdx < nFiles; ++fileIdx) {
+            chainCost += estimateConstraintFileCost(vFiles[fileIdx]);
+        }
+        for (int nRun = 0; nRun < nRepeatTimes; ++nRun) {
+            scheduler.submit(chainCost, [&, nRun]() {
+                dml::ClusteringState state;
+                for (int fileIdx = 0; fileIdx < nFiles; ++fileIdx) {
+                    runOnce(fileIdx, nRun, &state);
+                }
+            });
+        }
+    } else {
+        for (int fileIdx = 0; fileIdx < nFiles; ++fileIdx) {
+            float jobCost = estimateConstraintFileCost(vFiles[fileIdx]);
+            for (int nRun = 0; nRun < nRepeatTimes; ++nRun) {
+                scheduler.submit(jobCost, [&, fileIdx, nRun]() {
+                    runOnce(fileIdx, nRun, nullptr);
+                });
+            }
         }
-        // resultOfAllExperiments.push_back(avgResult);
-
-        std::string resultFullName = params["resultDir"] + params["resultFile"];
-        appendResult(avgResult, resultFullName);
-        progressCount ++;
-
-        std::cout << "Progress: " << (progressCount / vFiles.size() * 100.0) << std::endl;
     }
+    std::cout << "Run " << nFiles * nRepeatTimes << " runs on "
+        << scheduler.getNumWorkers() << " workers\n";
+    scheduler.runAll();
+    std::cout << "Jobs stolen between workers: " << scheduler.getNumStolen() << std::endl;
 
     // save result to json file to analyse
 	// std::string resultFullName = params["resultDir"] + params["resultFile"];
@@ -196,35 +484,73 @@ std::vector<std::string> getListOfConstraintFile(
     return vFiles;
 }
 
-dml::EMResult executeAlgo(std::string algoName, std::string constraintFileName,
-        const MatrixXf& X, int nClusters, int maxIter, float minObjChange,
-        std::vector<int>& vAssign ) {
-    std::cout << "\nExecute " << algoName << " with " << constraintFileName << "\n";
-
-    dml::EMKMeans* emkmeans;
+template <typename Storage, typename Acc>
+dml::EMResult executeAlgo(const RunRequest& request,
+        const Ref<const MatrixX<Storage> >& X, const RunOptions& options,
+        std::vector<int>& vAssign, dml::ClusteringState* state) {
+    const std::string& algoName = request.algoName;
+    const std::string& checkpointName = request.checkpointName;
+    int nClusters = request.nClusters;
+    dml::ConstraintPtr constraints = request.constraints;
+    std::cout << "\nExecute " << algoName << " with " << request.constraintName << "\n";
+
+    // the metric is chosen here, once per run: each algorithm is instantiated
+    // with its metric policy, so the distances are evaluated without dispatch
+    dml::EMKMeans<Storage, Acc>* emkmeans;
     if (0 == algoName.compare("PCKMEANS_NOMETRIC")) {
-        emkmeans = new dml::GlobalMetricKMeans(
-			X, nClusters, constraintFileName, dml::DIST_EUCLIDEAN);
+        emkmeans = new dml::GlobalMetricKMeans<dml::EuclideanMetric, Storage, Acc>(
+			X, nClusters, constraints);
     } else if (0 == algoName.compare("MPCKMEANS_GLOBAL_DIAGONAL")) {
-		emkmeans = new dml::GlobalMetricKMeans(
-			X, nClusters, constraintFileName, dml::DIST_MAHALANOBIS_DIAG);
+		emkmeans = new dml::GlobalMetricKMeans<dml::DiagonalMetric, Storage, Acc>(
+			X, nClusters, constraints);
     } else if (0 == algoName.compare("MPCKMEANS_GLOBAL_FULL")) {
-        emkmeans = new dml::GlobalMetricKMeans(
-			X, nClusters, constraintFileName, dml::DIST_MAHALANOBIS_FULL);
+        emkmeans = new dml::GlobalMetricKMeans<dml::FullMetric, Storage, Acc>(
+			X, nClusters, constraints);
     } else if (0 == algoName.compare("MPCKMEANS_LOCAL_DIAGONAL")) {
-        emkmeans = new dml::MPCKMeans(
-			X, nClusters, constraintFileName, dml::COV_DIAG);
+        emkmeans = new dml::MPCKMeans<dml::DiagonalMetric, Storage, Acc>(
+			X, nClusters, constraints);
     } else if (0 == algoName.compare("MPCKMEANS_LOCAL_FULL")) {
-        emkmeans = new dml::MPCKMeans(
-			X, nClusters, constraintFileName, dml::COV_FULL);
+        emkmeans = new dml::MPCKMeans<dml::FullMetric, Storage, Acc>(
+			X, nClusters, constraints);
+    } else if (0 == algoName.compare("MPCKMEANS_GLOBAL_LOWRANK")) {
+        emkmeans = new dml::GlobalMetricKMeans<dml::LowRankMetric, Storage, Acc>(
+			X, nClusters, constraints);
+    } else if (0 == algoName.compare("MPCKMEANS_LOCAL_LOWRANK")) {
+        emkmeans = new dml::MPCKMeans<dml::LowRankMetric, Storage, Acc>(
+			X, nClusters, constraints);
     } else {
         throw std::runtime_error("Can not detect algorithm " + algoName);
     }
 
+    emkmeans->setNumThreads(options.nThreads);
+    emkmeans->setSeed(request.seed);
+    emkmeans->setOnlineUpdate(options.onlineUpdate);
+    emkmeans->setDiameterMethod(options.diameterMethod);
+    emkmeans->setConstraintModel(options.constraintModel);
+    emkmeans->setBoundPruning(options.boundPruning);
+    emkmeans->setCenterIndex(options.centerIndex);
+    emkmeans->setMiniBatchSize(options.miniBatchSize);
+    emkmeans->setMetricRank(options.metricRank);
+    // one write per message, the clusters may be updated concurrently
+    emkmeans->setLogger([](const std::string& message) { std::cout << message; });
+    if (state && !state->empty()) {
+        emkmeans->setWarmStart(*state);
+    }
+    if (!checkpointName.empty()) {
+        emkmeans->setCheckpoint(checkpointName, options.checkpointEvery);
+        // a run that died (or was stopped) continues from its last checkpoint
+        if (options.resumeCheckpoints && std::ifstream(checkpointName.c_str()).good()) {
+            emkmeans->setResume(checkpointName);
+        }
+    }
+
     dml::EMResult result;
     try {
-        vAssign = emkmeans->doClustering(maxIter, minObjChange);
+        vAssign = emkmeans->doClustering(request.maxIter, request.minObjChange);
         result = emkmeans->getResult();
+        if (state) {
+            *state = emkmeans->getState();
+        }
     } catch (...) {
         std::cout << "DIE HARD\n";
         result.reachLocalMinimal = -1;//case error
@@ -234,6 +560,179 @@ dml::EMResult executeAlgo(std::string algoName, std::string constraintFileName,
 	return result;
 }
 
+AlgoRunner makeAlgoRunner(const std::string precision, dml::DataMatrix dataset,
+        const RunOptions& options) {
+    // mean-normalize input data (subtract mean from each column of X),
+    // centered once and shared read-only by all runs
+    dml::DataMatrix::MapType X = dataset.matrix();
+    VectorXf mean = X.rowwise().mean();
+    if (0 == precision.compare("float") || 0 == precision.compare("double")) {
+        auto Xf = std::make_shared<const MatrixXf>(X.colwise() - mean);
+        if (0 == precision.compare("float")) {
+            return [=](const RunRequest& request, std::vector<int>& vAssign,
+                    dml::ClusteringState* state) {
+                return executeAlgo<float, float>(request, *Xf, options, vAssign, state);
+            };
+        }
+        return [=](const RunRequest& request, std::vector<int>& vAssign,
+                dml::ClusteringState* state) {
+            return executeAlgo<float, double>(request, *Xf, options, vAssign, state);
+        };
+    } else if (0 == precision.compare("half")) {
+        // centered and converted by blocks of columns, straight from the
+        // loaded data: no float copy of the whole data set
+        const Index blockCols = 4096;
+        auto Xh = std::make_shared<MatrixX<Eigen::half> >(X.rows(), X.cols());
+        for (Index col = 0; col < X.cols(); col += blockCols) {
+            Index nCols = std::min(blockCols, X.cols() - col);
+            Xh->middleCols(col, nCols) = (X.middleCols(col, nCols).colwise() - mean).cast<Eigen::half>();
+        }
+        return [=](const RunRequest& request, std::vector<int>& vAssign,
+                dml::ClusteringState* state) {
+            return executeAlgo<Eigen::half, float>(request, *Xh, options, vAssign, state);
+        };
+    }
+    throw std::runtime_error("Can not detect precision " + precision);
+}
+
+void serveClustering(const RunRequest& defaults, const std::string& dataDir,
+        AlgoRunner runAlgo, int nData, const std::vector<int>& vGroundTruthLabel,
+        int nClasses, const std::string& socketPath, std::ostream& out) {
+    // the last solution of each session, and the algorithm that found it
+    struct Session {
+        std::string algoName;
+        dml::ClusteringState state;
+        unsigned long lastUse = 0;
+    };
+    const size_t MAX_SESSIONS = 64;
+    std::map<std::string, Session> sessions;
+    unsigned long useCount = 0;
+
+    dml::RequestHandler handler = [&](const std::vector<std::string>& lines, std::ostream& response) {
+        RunRequest request = defaults;
+        request.seed = (unsigned) std::rand();  // the requests are served one at a time
+        std::string sessionName = "default";
+        bool warmStart = true;
+        std::vector<std::pair<int, int> > mlLinks, clLinks;
+        try {
+            for (const std::string& line : lines) {
+                std::istringstream iss(line);
+                std::string key;
+                if (!(iss >> key)) continue;
+                if (0 == key.compare("session")) {
+                    iss >> sessionName;
+                } else if (0 == key.compare("algo")) {
+                    iss >> request.algoName;
+                } else if (0 == key.compare("numberClusters")) {
+                    iss >> request.nClusters;
+                } else if (0 == key.compare("maxIteration")) {
+                    iss >> request.maxIter;
+                } else if (0 == key.compare("minObjectiveFunctionChange")) {
+                    iss >> request.minObjChange;
+                } else if (0 == key.compare("warmStart")) {
+                    iss >> warmStart;
+                } else if (0 == key.compare("constraintFile")) {
+                    std::string name;
+                    iss >> name;
+                    request.constraintName = ('/' == name[0]) ? name : dataDir + name;
+                } else if (0 == key.compare("ml") || 0 == key.compare("cl")) {
+                    std::pair<int, int> link;
+                    iss >> link.first >> link.second;
+                    if (std::min(link.first, link.second) < 0 || std::max(link.first, link.second) >= nData) {
+                        throw std::runtime_error("Point out of the data set: " + line);
+                    }
+                    (0 == key.compare("ml") ? mlLinks : clLinks).push_back(link);
+                } else {
+                    throw std::runtime_error("Unknown key " + key);
+                }
+                if (iss.fail()) {
+                    throw std::runtime_error("Can not parse: " + line);
+                }
+            }
+            if (request.nClusters < 1 || request.nClusters > nData) {
+                throw std::runtime_error("numberClusters must be in [1, " + std::to_string(nData) + "]");
+            }
+            if (request.maxIter <= 0) {
+                throw std::runtime_error("maxIteration must be positive");
+            }
+
+            if (!request.constraintName.empty()) {
+                if (!mlLinks.empty() || !clLinks.empty()) {
+                    throw std::runtime_error("Both a constraint file and inline constraints");
+                }
+                request.constraints = dml::ConstraintsCache::instance().get(request.constraintName);
+            } else {
+                std::shared_ptr<dml::ConstraintsManager> constraints(new dml::ConstraintsManager(""));
+                constraints->refineConstraints(mlLinks, clLinks);
+                constraints->deriveConnectedComponents();
+                constraints->nConstraintsOriginal = (int) (mlLinks.size() + clLinks.size());
+                constraints->nConstraintsDeduced = constraints->nConstraintsOriginal;
+                request.constraints = constraints;
+                request.constraintName = "inline constraints of session " + sessionName;
+            }
+
+            // a new session takes the place of the least recently used one
+            if (0 == sessions.count(sessionName) && sessions.size() >= MAX_SESSIONS) {
+                auto oldest = sessions.begin();
+                for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+                    if (it->second.lastUse < oldest->second.lastUse) oldest = it;
+                }
+                sessions.erase(oldest);
+            }
+            // a solution of another algorithm or K can not seed this run
+            Session& session = sessions[sessionName];
+            session.lastUse = ++useCount;
+            if (!warmStart || 0 != session.algoName.compare(request.algoName)
+                || session.state.means.cols() != request.nClusters) {
+                session.state = dml::ClusteringState();
+            }
+            session.algoName = request.algoName;
+
+            std::vector<int> vAssign;
+            auto t1 = std::chrono::high_resolution_clock::now();
+            dml::EMResult result = runAlgo(request, vAssign, &session.state);
+            auto t2 = std::chrono::high_resolution_clock::now();
+            if (-1 == result.reachLocalMinimal) {
+                session.state = dml::ClusteringState();
+                throw std::runtime_error("The clustering failed");
+            }
+            result.duration = (float) std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+            if ((int) vGroundTruthLabel.size() == nData) {
+                result.vMeasure = VMeasure(vAssign, vGroundTruthLabel, nClasses, request.nClusters);
+            }
+
+            response << "ok " << vAssign.size() << "\n";
+            for (size_t idx = 0; idx < vAssign.size(); ++idx) {
+                response << (idx > 0 ? " " : "") << vAssign[idx];
+            }
+            response << "\n" << result.toJson() << "\n";
+        } catch (const std::exception& e) {
+            response << "error " << e.what() << "\n";
+        }
+    };
+
+    if (socketPath.empty()) {
+        std::cout << "Serving requests on stdin" << std::endl;
+        dml::serveStream(std::cin, out, handler);
+    } else {
+        std::cout << "Serving requests on " << socketPath << std::endl;
+        dml::serveUnixSocket(socketPath, handler);
+    }
+}
+
+float estimateConstraintFileCost(const std::string constraintFileName) {
+    std::ifstream infile((constraintFileName + ".links").c_str(),
+        std::ios::binary | std::ios::ate);
+    return infile.is_open() ? 1.0f + (float) infile.tellg() : 1.0f;
+}
+
+void printLoadStats(const std::string fileName, const dml::LoadStats& stats) {
+    if (0 == stats.nBytes) return;
+    std::cout << "Parsed " << fileName << ": " << stats.nBytes << " bytes, "
+        << stats.nTokens << " tokens in " << stats.milliseconds << " ms ("
+        << stats.throughputMBs() << " MB/s, " << stats.nThreads << " threads)\n";
+}
+
 dml::EMResult calculateAvgResult(const std::vector<dml::EMResult>& allResults) {
     dml::EMResult avgResult;
     int nResultOk = 0;
@@ -7,6 +7,11 @@
 
 #include "MPCKMeans.h"
 #include "../utils/functionUtils.h"
+#include "../utils/parallelUtils.h"
+#include "../gaussian/SimpleGaussian.cpp"
+#include "../gaussian/DiagGaussian.cpp"
+#include "../gaussian/FullGaussian.cpp"
+#include "../gaussian/LowRankGaussian.cpp"
 
 #include <iostream>
 #include <limits>
@@ -15,20 +20,57 @@ namespace dml {
 
 using namespace Eigen;
 
-MPCKMeans::MPCKMeans(const ConstMatrixRef& dataset, const int numClts,
-	const std::string constraintFileName, const CovType type)
-	:PCKMeans(dataset, numClts, constraintFileName, type) {}
-
-MPCKMeans::~MPCKMeans() {}
+template <typename Metric, typename Storage, typename Acc>
+MPCKMeans<Metric, Storage, Acc>::MPCKMeans(const ConstDataRef& dataset, const int numClts,
+	const std::string constraintFileName)
+	:Base(dataset, numClts, constraintFileName, Metric::covType) {
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		vLocalGaussian.push_back(static_cast<LocalGaussian*>(vMixture.at(cltId).get()));
+	}
+}
 
-/*virtual*/ void MPCKMeans::updateMixtures() {
+template <typename Metric, typename Storage, typename Acc>
+MPCKMeans<Metric, Storage, Acc>::MPCKMeans(const ConstDataRef& dataset, const int numClts,
+	const ConstraintPtr constraints)
+	:Base(dataset, numClts, constraints, Metric::covType) {
 	for (int cltId = 0; cltId < nClusters; ++cltId) {
-		vMixture.at(cltId)->updateMean();
-		vMixture.at(cltId)->updateConstraintImpact(data, vAssign, constr);
-		vMixture.at(cltId)->cacheDistPoint2Point(data);
-		vMixture.at(cltId)->cacheDistPoint2Mean(data);
-		// vMixture.at(cltId)->debugCachedDistance();
+		vLocalGaussian.push_back(static_cast<LocalGaussian*>(vMixture.at(cltId).get()));
 	}
 }
 
+template <typename Metric, typename Storage, typename Acc>
+MPCKMeans<Metric, Storage, Acc>::~MPCKMeans() {}
+
+template <typename Metric, typename Storage, typename Acc>
+/*virtual*/ void MPCKMeans<Metric, Storage, Acc>::updateMixtures() {
+	// the component moments are computed once and read by every cluster
+	typename LocalGaussian::Parts parts;
+	if (CONSTRAINT_COMPONENTS == this->constraintModel && COV_NONE != Metric::covType) {
+		componentMoments(data, vAssign, constr->components, parts);
+	}
+	// the M-step of one cluster only reads data, vAssign, constr and parts and
+	// only writes its own gaussian, so the clusters are updated concurrently
+	parallelFor(nClusters, this->nThreads, [&](int cltId) {
+		LocalGaussian* gaussian = vLocalGaussian[cltId];
+		gaussian->updateMean();
+		gaussian->updateConstraintImpact(data, vAssign, constr, parts);
+		gaussian->cacheConstraintDistances(data, constr);
+		// gaussian->debugCachedDistance();
+	});
+	this->cacheDistPoint2Mean();
+}
+
+template class MPCKMeans<EuclideanMetric, float, float>;
+template class MPCKMeans<EuclideanMetric, float, double>;
+template class MPCKMeans<EuclideanMetric, Eigen::half, float>;
+template class MPCKMeans<DiagonalMetric, float, float>;
+template class MPCKMeans<DiagonalMetric, float, double>;
+template class MPCKMeans<DiagonalMetric, Eigen::half, float>;
+template class MPCKMeans<FullMetric, float, float>;
+template class MPCKMeans<FullMetric, float, double>;
+template class MPCKMeans<FullMetric, Eigen::half, float>;
+template class MPCKMeans<LowRankMetric, float, float>;
+template class MPCKMeans<LowRankMetric, float, double>;
+template class MPCKMeans<LowRankMetric, Eigen::half, float>;
+
 } /* namespace dml */
@@ -11,20 +11,51 @@
 #include "../pckmeans/PCKMeans.h"
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace dml {
 
-typedef std::shared_ptr<ConstraintsManager> ConstraintPtr;
-
-class MPCKMeans : public PCKMeans {
+/**
+ * one local metric per cluster, Metric is DiagonalMetric, FullMetric or LowRankMetric
+ */
+template <typename Metric, typename Storage = float, typename Acc = float>
+class MPCKMeans : public PCKMeans<Storage, Acc> {
 public:
-	MPCKMeans(const ConstMatrixRef& dataset, const int numClts,
-		const std::string constraintFileName, const CovType type = COV_DIAG);
+	typedef PCKMeans<Storage, Acc> Base;
+	typedef typename Metric::template GaussianType<Storage, Acc> LocalGaussian;
+	typedef typename Base::ConstDataRef ConstDataRef;
+
+	MPCKMeans(const ConstDataRef& dataset, const int numClts,
+		const std::string constraintFileName);
+	MPCKMeans(const ConstDataRef& dataset, const int numClts,
+		const ConstraintPtr constraints);
 
 	virtual ~MPCKMeans();
 	virtual void updateMixtures();
+
+protected:
+	using Base::nClusters;
+	using Base::data;
+	using Base::vAssign;
+	using Base::vMixture;
+	using Base::constr;
+
+	std::vector<LocalGaussian*> vLocalGaussian;	// vMixture with its concrete type
 };
 
+extern template class MPCKMeans<EuclideanMetric, float, float>;
+extern template class MPCKMeans<EuclideanMetric, float, double>;
+extern template class MPCKMeans<EuclideanMetric, Eigen::half, float>;
+extern template class MPCKMeans<DiagonalMetric, float, float>;
+extern template class MPCKMeans<DiagonalMetric, float, double>;
+extern template class MPCKMeans<DiagonalMetric, Eigen::half, float>;
+extern template class MPCKMeans<FullMetric, float, float>;
+extern template class MPCKMeans<FullMetric, float, double>;
+extern template class MPCKMeans<FullMetric, Eigen::half, float>;
+extern template class MPCKMeans<LowRankMetric, float, float>;
+extern template class MPCKMeans<LowRankMetric, float, double>;
+extern template class MPCKMeans<LowRankMetric, Eigen::half, float>;
+
 } /* namespace dml */
 
 #endif /* MPCKMEANS_PCKMEANS_H_ */
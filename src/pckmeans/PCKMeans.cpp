@@ -7,111 +7,476 @@
 
 #include "PCKMeans.h"
 #include "../utils/functionUtils.h"
+#include "../constraint/ConstraintsCache.h"
+#include "../utils/parallelUtils.h"
 
+#include <algorithm>
 #include <iostream>
 #include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace dml {
 
 using namespace Eigen;
 
-PCKMeans::PCKMeans(const ConstMatrixRef& dataset, const int numClts,
+template <typename Storage, typename Acc>
+PCKMeans<Storage, Acc>::PCKMeans(const ConstDataRef& dataset, const int numClts,
 	const std::string constraintFileName, const CovType type)
-	:EMKMeans(dataset, numClts, type) {	
-	constr = ConstraintPtr(new ConstraintsManager(constraintFileName));
-	constr->readConstraintsFromFile();
-	constr->readConnectedComponents();
+	:PCKMeans(dataset, numClts,
+		ConstraintsCache::instance().get(constraintFileName), type) {}
+
+template <typename Storage, typename Acc>
+PCKMeans<Storage, Acc>::PCKMeans(const ConstDataRef& dataset, const int numClts,
+	const ConstraintPtr constraints, const CovType type)
+	:Base(dataset, numClts, type), constr(constraints) {
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		vMetric.push_back(vMixture.at(cltId).get());
+	}
+	for (int idx = 0; idx < nData; ++idx) {
+		if (ConstraintColoring::UNCOLORED == constr->coloring.colorOf(idx)) {
+			vUnconstrained.push_back(idx);
+		}
+	}
 	// constr->dumpConstraints();
 	// std::cout << "Using : " << constr->numML << " mustlinks deduced (coeff " << constr->mlConst << ")\n"
     // << "Using : " << constr->numCL << " cannotlinks deduced (coeff " << constr->clConst << ")\n";
 }
 
-PCKMeans::~PCKMeans() {}
+template <typename Storage, typename Acc>
+PCKMeans<Storage, Acc>::~PCKMeans() {}
 
-/*virtual*/ void PCKMeans::createInitCenters() {
-	MatrixXf initCenters = constr->genInitCentersFromML(data, nClusters);
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::createInitCenters() {
+	MatrixXf initCenters = constr->genInitCentersFromML<Storage>(data, nClusters, rng);
 	for (int cltId = 0; cltId < nClusters; ++cltId) {
 		vMixture.at(cltId)->setInitCenter(initCenters.col(cltId));
 	}
 }
 
-/*virtual*/ void PCKMeans::doVeryFirstClustering() {
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::doVeryFirstClustering() {
 	for (int cltId = 0; cltId < nClusters; ++cltId) {
-		vMixture.at(cltId)->cacheDistPoint2Point(data);
-		vMixture.at(cltId)->cacheDistPoint2Mean(data);
+		vMixture.at(cltId)->cacheConstraintDistances(data, constr);
 	}
+	cacheDistPoint2Mean();
 }
 
-/*virtual*/ void PCKMeans::findBestCluster(const std::vector<int>& randomIndex) {
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::findBestCluster(const std::vector<int>& randomIndex) {
+	if (CONSTRAINT_COMPONENTS == constraintModel) {
+		if (1 == currIter && logger) {
+			logger("Constraint model components: the ML / CL penalties of the E-step are "
+				"approximated by the distances to the group centers\n");
+		}
+		buildComponentStats();
+	} else if (nThreads > 1) {
+		if (onlineUpdate && 1 == currIter && logger) {
+			logger("Online update ignored: the E-step runs on " + std::to_string(nThreads) + " threads\n");
+		}
+		// the coloring is the one of the expanded links
+		findBestClusterByColor();
+		return;
+	}
+	// the statistics of the gaussians match vAssign from the second pass on
+	if (onlineUpdate && currIter > 0) {
+		findBestClusterOnline(randomIndex);
+		return;
+	}
 	for (int i = 0; i < nData; ++i) {
 		int idx = randomIndex[i];
+		reassign(idx, bestCluster(idx));
+	}
+}
+
+template <typename Storage, typename Acc>
+void PCKMeans<Storage, Acc>::reassign(const int idx, const int cltId) {
+	int oldClt = vAssign[idx];
+	vAssign[idx] = cltId;
+	if (CONSTRAINT_COMPONENTS != constraintModel || oldClt == cltId) return;
+
+	int comp = constr->components.componentOf(idx);
+	if (ConstraintComponents::NO_COMPONENT == comp) return;
+	std::vector<GroupSum>& parts = compParts[comp];
+	GroupSum* oldPart = findGroupSum(comp, oldClt);
+	if (0 == --oldPart->count) {
+		parts.erase(parts.begin() + (oldPart - parts.data()));
+	} else {
+		oldPart->sum -= data.col(idx).template cast<float>();
+	}
+	GroupSum* newPart = findGroupSum(comp, cltId);
+	if (nullptr == newPart) {
+		auto it = std::lower_bound(parts.begin(), parts.end(), cltId,
+			[](const GroupSum& part, const int id) { return part.cltId < id; });
+		newPart = &*parts.insert(it, GroupSum{cltId, 0, VectorXf::Zero(nDims)});
+	}
+	newPart->count++;
+	newPart->sum += data.col(idx).template cast<float>();
+}
+
+template <typename Storage, typename Acc>
+void PCKMeans<Storage, Acc>::findBestClusterOnline(const std::vector<int>& randomIndex) {
+	vMeanMoved.assign(nClusters, 0);	// distP2M was filled by the last M-step
+	vMetricMoved.assign(nClusters, 0);
+	movedMeans.resize(nDims, nClusters);
+	auto markMoved = [&](const int cltId) {
+		movedMeans.col(cltId) = vMixture[cltId]->getMean().template cast<float>();
+		vMeanMoved[cltId] = 1;
+	};
+
+	for (int i = 0; i < nData; ++i) {
+		int idx = randomIndex[i];
+		int oldClt = vAssign[idx];
+		int newClt = bestCluster(idx);
+		// a cluster is never emptied
+		if (newClt == oldClt || vMixture[oldClt]->getSize() <= 1) continue;
+
+		reassign(idx, newClt);
+		vMixture[oldClt]->removeFromMean(data.col(idx));
+		vMixture[newClt]->addToMean(data.col(idx));
+		// the diagonal statistics of the two local metrics
+		if (vMetric[oldClt]->movePoint(data, idx, oldClt, vAssign, constr)) {
+			vMetricMoved[oldClt] = 1;
+		}
+		if (vMetric[newClt] != vMetric[oldClt] && vMetric[newClt]->movePoint(data, idx, oldClt, vAssign, constr)) {
+			vMetricMoved[newClt] = 1;
+		}
+		markMoved(oldClt);
+		markMoved(newClt);
+	}
+	vMeanMoved.clear();		// the M-step fills distP2M and the link distances again
+	vMetricMoved.clear();
+}
+
+template <typename Storage, typename Acc>
+void PCKMeans<Storage, Acc>::findBestClusterByColor() {
+	// each point takes its best cluster given the current assignment of the
+	// others; points of one color share no constraint so their moves do not
+	// interact and every move still decreases the objective
+	const int BLOCK_SIZE = 256;
+	auto assignAll = [&](const int* first, const int nPoints) {
+		int nBlocks = (nPoints + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		parallelFor(nBlocks, nThreads, [&](int blockId) {
+			const int* last = first + std::min(nPoints, (blockId + 1) * BLOCK_SIZE);
+			for (const int* p = first + blockId * BLOCK_SIZE; p < last; ++p) {
+				vAssign[*p] = bestCluster(*p);
+			}
+		});
+	};
+
+	// the diameters are estimated lazily, not while the threads read them
+	for (GaussianType* gaussian : vMetric) {
+		gaussian->ensureDiameter(data);
+	}
+
+	const ConstraintColoring& coloring = constr->coloring;
+	assignAll(vUnconstrained.data(), (int) vUnconstrained.size());
+	for (int color = 0; color < coloring.numColors(); ++color) {
+		assignAll(coloring.begin(color), coloring.size(color));
+	}
+}
+
+template <typename Storage, typename Acc>
+int PCKMeans<Storage, Acc>::bestCluster(const int idx) {
+	if (CONSTRAINT_COMPONENTS == constraintModel) {
+		return bestClusterByComponents(idx);
+	}
+	float minCost = std::numeric_limits<float>::max();
+	int minIndex = -1;
 
-		float minCost = std::numeric_limits<float>::max();
-		int minIndex = -1;
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		float cost = getVariance(idx, cltId)
+		        + constr->mlConst * getMustLinksPenalty(idx, cltId)
+		        + constr->clConst * getCannotLinksPenalty(idx, cltId);
 
-		for (int cltId = 0; cltId < nClusters; ++cltId) {
-			float cost = getVariance(idx, cltId)
-			        + constr->mlConst * getMustLinksPenalty(idx, cltId)
-			        + constr->clConst * getCannotLinksPenalty(idx, cltId);
+		if (cost < minCost) {
+			minCost = cost;
+			minIndex = cltId;
+		}
+	}
+	return minIndex;
+}
 
-			if (cost < minCost) {
-				minCost = cost;
-				minIndex = cltId;
+template <typename Storage, typename Acc>
+void PCKMeans<Storage, Acc>::buildComponentStats() {
+	const ConstraintComponents& components = constr->components;
+	int nComps = components.numComponents();
+	compParts.assign(nComps, std::vector<GroupSum>());
+	std::vector<std::pair<int, int> > byCluster;	// (cltId, idx)
+	for (int comp = 0; comp < nComps; ++comp) {
+		byCluster.clear();
+		for (const int& idx : components.members(comp)) {
+			byCluster.push_back(std::make_pair(vAssign[idx], idx));
+		}
+		std::sort(byCluster.begin(), byCluster.end());
+		std::vector<GroupSum>& parts = compParts[comp];
+		for (const auto& member : byCluster) {
+			if (parts.empty() || parts.back().cltId != member.first) {
+				parts.push_back(GroupSum{member.first, 0, VectorXf::Zero(nDims)});
 			}
+			parts.back().count++;
+			parts.back().sum += data.col(member.second).template cast<float>();
 		}
-		vAssign[idx] = minIndex;
 	}
 }
 
-/*virtual*/ float PCKMeans::distanceByCluster(int idx1, int idx2, int cltId) {
-	return vMixture.at(cltId)->distance(idx1, idx2);
+template <typename Storage, typename Acc>
+typename PCKMeans<Storage, Acc>::GroupSum* PCKMeans<Storage, Acc>::findGroupSum(
+	const int comp, const int cltId) {
+	std::vector<GroupSum>& parts = compParts[comp];
+	auto it = std::lower_bound(parts.begin(), parts.end(), cltId,
+		[](const GroupSum& part, const int id) { return part.cltId < id; });
+	return (it != parts.end() && it->cltId == cltId) ? &*it : nullptr;
 }
 
-/*virtual*/ float PCKMeans::distanceToMeanOfCluster(int idx, int cltId) {
-	return vMixture.at(cltId)->distanceToMean(idx);
+template <typename Storage, typename Acc>
+int PCKMeans<Storage, Acc>::collectGroupParts(const int comp, const int skipIdx,
+	std::vector<GroupPart>& parts, int nParts) {
+	int skipClt = (skipIdx >= 0) ? vAssign[skipIdx] : -1;
+	for (const GroupSum& group : compParts[comp]) {
+		int cltId = group.cltId;
+		int count = group.count - ((cltId == skipClt) ? 1 : 0);
+		if (count <= 0) continue;
+		if (nParts == (int) parts.size()) parts.emplace_back();
+		GroupPart& part = parts[nParts++];
+		part.cltId = cltId;
+		part.count = count;
+		part.center = group.sum;
+		if (cltId == skipClt) {
+			part.center -= data.col(skipIdx).template cast<float>();
+		}
+		part.center /= (float) count;
+		part.ownDist = 0.0f;
+	}
+	return nParts;
 }
 
-/*virtual*/ float PCKMeans::maxDistanceByCluster(int cltId) {
-	return vMixture.at(cltId)->getMaxDistance();
+template <typename Storage, typename Acc>
+int PCKMeans<Storage, Acc>::bestClusterByComponents(const int idx) {
+	const ConstraintComponents& components = constr->components;
+	int comp = components.componentOf(idx);
+
+	// the other members of the component of idx, and the members of the
+	// components cannot-linked to it, by cluster. The parts are kept by each
+	// thread across the points it assigns
+	static thread_local std::vector<GroupPart> mlParts, clParts;
+	int nML = 0, nCL = 0;
+	if (ConstraintComponents::NO_COMPONENT != comp) {
+		nML = collectGroupParts(comp, idx, mlParts, 0);
+		for (int p = 0; p < nML; ++p) {
+			mlParts[p].ownDist = vMetric[mlParts[p].cltId]->distanceToCenter(data.col(idx), mlParts[p].center);
+		}
+		for (const int& comp2 : components.cannotLinked(comp)) {
+			nCL = collectGroupParts(comp2, -1, clParts, nCL);
+		}
+	}
+
+	float minCost = std::numeric_limits<float>::max();
+	int minIndex = -1;
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		float mlPenalty = 0.0f, clPenalty = 0.0f;
+		for (int p = 0; p < nML; ++p) {
+			const GroupPart& part = mlParts[p];
+			if (part.cltId == cltId) continue;
+			mlPenalty += 0.5 * part.count * (
+				vMetric[cltId]->distanceToCenter(data.col(idx), part.center) +
+				part.ownDist
+			);
+		}
+		for (int p = 0; p < nCL; ++p) {
+			const GroupPart& part = clParts[p];
+			if (part.cltId != cltId) continue;
+			clPenalty += part.count * (
+				maxDistanceByCluster(cltId) -
+				vMetric[cltId]->distanceToCenter(data.col(idx), part.center)
+			);
+		}
+		float cost = getVariance(idx, cltId)
+		        + constr->mlConst * mlPenalty
+		        + constr->clConst * clPenalty;
+
+		if (cost < minCost) {
+			minCost = cost;
+			minIndex = cltId;
+		}
+	}
+	return minIndex;
 }
 
-/*virtual*/ float PCKMeans::logDetByCluster(int cltId) {
-	return vMixture.at(cltId)->getLogDet();
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::cacheDistPoint2Mean() {
+	// each cluster fills its own column of distP2M
+	distP2M.resize(nData, nClusters);
+	parallelFor(nClusters, nThreads, [&](int cltId) {
+		vMixture.at(cltId)->cacheDistPoint2Mean(data, distP2M.col(cltId));
+	});
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::startMiniBatch() {
+	if (CONSTRAINT_PAIRS != constraintModel) {
+		throw std::runtime_error("The mini-batch mode uses the pairs constraint model\n");
+	}
+	// distanceToMeanOfCluster reads movedMeans, refreshed for each batch
+	vMeanMoved.assign(nClusters, 1);
+	movedMeans.resize(nDims, nClusters);
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		vMetric[cltId]->cacheConstraintDistances(data, constr);
+	}
+	nBatchesSinceCommit = 0;
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::sampleBatch(std::vector<int>& batch) {
+	Base::sampleBatch(batch);
+	// with the constraint neighbours, the two ends of a link move together
+	int nSampled = (int) batch.size();
+	for (int i = 0; i < nSampled; ++i) {
+		for (const ConstraintAdjacency* links : {&constr->ML, &constr->CL}) {
+			for (const int& other : links->neighbors(batch[i])) batch.push_back(other);
+		}
+	}
+	std::sort(batch.begin(), batch.end());
+	batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+	shuffleVector(batch, rng);
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ float PCKMeans<Storage, Acc>::miniBatchStep(const std::vector<int>& batch) {
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		movedMeans.col(cltId) = vMixture[cltId]->getMean().template cast<float>();
+	}
+	float cost = 0.0f;
+	for (const int& idx : batch) {
+		int cltId = bestCluster(idx);
+		reassign(idx, cltId);
+		cost += pointCost(idx, cltId);
+	}
+	for (const int& idx : batch) {
+		int cltId = vAssign[idx];
+		vMixture[cltId]->stepMean(data.col(idx));
+		vMetric[cltId]->stepStatistics(data, idx, vAssign, constr);
+	}
+	if (++nBatchesSinceCommit * miniBatchSize >= nData) {
+		commitMiniBatchMetrics();
+		nBatchesSinceCommit = 0;
+	}
+	return cost;
 }
 
-float PCKMeans::getVariance(const int idx, const int cltId) {
+template <typename Storage, typename Acc>
+void PCKMeans<Storage, Acc>::commitMiniBatchMetrics() {
+	int nSeen = 0;
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		nSeen += vMixture[cltId]->getSeen();
+	}
+	for (GaussianType* gaussian : metricGaussians()) {
+		// logDet is normalized by the expected number of members
+		Acc sizeEstimate = (GLOBAL_GAUSSIAN_ID == gaussian->getClusterId()) ? Acc(nData)
+			: std::max(Acc(1), Acc(nData) * gaussian->getSeen() / std::max(1, nSeen));
+		gaussian->commitStatistics(sizeEstimate);
+		gaussian->cacheConstraintDistances(data, constr);
+	}
+}
+
+template <typename Storage, typename Acc>
+std::vector<typename PCKMeans<Storage, Acc>::GaussianType*> PCKMeans<Storage, Acc>::metricGaussians() {
+	std::vector<GaussianType*> gaussians;
+	for (GaussianType* gaussian : vMetric) {
+		if (std::find(gaussians.begin(), gaussians.end(), gaussian) == gaussians.end()) {
+			gaussians.push_back(gaussian);
+		}
+	}
+	return gaussians;
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::saveMetrics(ClusteringState& state) {
+	for (GaussianType* gaussian : metricGaussians()) {
+		state.covDiags.push_back(VectorXf());
+		state.rotations.push_back(MatrixXf());
+		gaussian->getMetricParameters(state.covDiags.back(), state.rotations.back());
+		state.logDets.push_back(gaussian->getLogDet());
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::restoreMetrics(const ClusteringState& state) {
+	std::vector<GaussianType*> gaussians = metricGaussians();
+	if (state.covDiags.size() != gaussians.size()) {
+		throw std::runtime_error("The warm start state has a different number of metrics\n");
+	}
+	for (size_t k = 0; k < gaussians.size(); ++k) {
+		gaussians[k]->setMetricParameters(state.covDiags[k], state.rotations[k], state.logDets[k]);
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::resumeCaches() {
+	// the ones the last M-step left
+	for (GaussianType* gaussian : metricGaussians()) {
+		gaussian->cacheConstraintDistances(data, constr);
+	}
+	cacheDistPoint2Mean();
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::finishMiniBatch() {
+	for (int cltId = 0; cltId < nClusters; ++cltId) {
+		movedMeans.col(cltId) = vMixture[cltId]->getMean().template cast<float>();
+	}
+	for (int idx = 0; idx < nData; ++idx) {
+		reassign(idx, bestCluster(idx));
+	}
+	vObjFuncCached.push_back(calculateObjFunc());
+}
+
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::pointCost(const int idx, const int cltId) {
+	return getVariance(idx, cltId)
+		+ constr->mlConst * getMustLinksPenalty(idx, cltId)
+		+ constr->clConst * getCannotLinksPenalty(idx, cltId);
+}
+
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::getVariance(const int idx, const int cltId) {
 	return (
 		distanceToMeanOfCluster(idx, cltId) -
 		logDetByCluster(cltId)
 	);
 }
 
-float PCKMeans::getMustLinksPenalty(const int idx1, const int cltId1) {
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::getMustLinksPenalty(const int idx1, const int cltId1) {
 	float penalty = 0.0f;
-	if (constr->ML.count(idx1) > 0) {
-		for (const auto& idx2 : constr->ML.at(idx1)) {
-			int cltId2 = vAssign[idx2];
-			if (cltId1 != cltId2) {
-				penalty += 0.5 * (
-					distanceByCluster(idx1, idx2, cltId1) +
-					distanceByCluster(idx1, idx2, cltId2)
-				);
-			}
+	ConstraintAdjacency::Range mustLinks = constr->ML.neighbors(idx1);
+	for (int k = 0; k < mustLinks.size(); ++k) {
+		int cltId2 = vAssign[mustLinks.first[k]];
+		if (cltId1 != cltId2) {
+			int linkIdx = mustLinks.offset + k;
+			int idx2 = mustLinks.first[k];
+			penalty += 0.5 * (
+				mlDistanceByCluster(linkIdx, cltId1, idx1, idx2) +
+				mlDistanceByCluster(linkIdx, cltId2, idx1, idx2)
+			);
 		}
 	}
 	return penalty;
 }
 
-float PCKMeans::getCannotLinksPenalty(const int idx1, const int cltId1) {
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::getCannotLinksPenalty(const int idx1, const int cltId1) {
 	float penalty = 0.0f;
-	if (constr->CL.count(idx1) > 0) {
+	ConstraintAdjacency::Range cannotLinks = constr->CL.neighbors(idx1);
+	if (!cannotLinks.empty()) {
 		float maxDistanceOfThisCluster = maxDistanceByCluster(cltId1);
-		for (const auto& idx2 : constr->CL.at(idx1)) {
-			int cltId2 = vAssign[idx2];
+		for (int k = 0; k < cannotLinks.size(); ++k) {
+			int cltId2 = vAssign[cannotLinks.first[k]];
 			if (cltId1 == cltId2) {
 				penalty += (
 					maxDistanceOfThisCluster -
-					distanceByCluster(idx1, idx2, cltId1)
+					clDistanceByCluster(cannotLinks.offset + k, cltId1, idx1, cannotLinks.first[k])
 				);
 			}
 		}
@@ -119,15 +484,52 @@ float PCKMeans::getCannotLinksPenalty(const int idx1, const int cltId1) {
 	return penalty;
 }
 
-/*virtual*/ void PCKMeans::updateMixtures() {
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::setDiameterMethod(const DiameterMethod method) {
+	Base::setDiameterMethod(method);
+	for (GaussianType* gaussian : vMetric) {
+		gaussian->setDiameterMethod(method);
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::setConstraintModel(const ConstraintModel model) {
+	Base::setConstraintModel(model);
+	for (GaussianType* gaussian : vMetric) {
+		gaussian->setConstraintModel(model);
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::setLogger(const LogFunc& log) {
+	Base::setLogger(log);
+	for (GaussianType* gaussian : vMetric) {
+		gaussian->setLogger(log);
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::setMetricRank(const int rank) {
+	Base::setMetricRank(rank);
+	for (GaussianType* gaussian : vMetric) {
+		gaussian->setMetricRank(rank);
+	}
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ void PCKMeans<Storage, Acc>::updateMixtures() {
 	for (int cltId = 0; cltId < nClusters; ++cltId) {
 		vMixture.at(cltId)->updateMean();
-		vMixture.at(cltId)->cacheDistPoint2Point(data);
-		vMixture.at(cltId)->cacheDistPoint2Mean(data);
+		vMixture.at(cltId)->cacheConstraintDistances(data, constr);
 	}
+	cacheDistPoint2Mean();
 }
 
-/*virtual*/ float PCKMeans::calculateObjFunc() {
+template <typename Storage, typename Acc>
+/*virtual*/ float PCKMeans<Storage, Acc>::calculateObjFunc() {
+	if (CONSTRAINT_COMPONENTS == constraintModel) {
+		buildComponentStats();
+	}
 	float totalVar = totalVariance();
 	float totalMLPen = constr->mlConst * totalMLPenalty();
 	float totalCLPen = constr->clConst * totalCLPenalty();
@@ -137,7 +539,8 @@ float PCKMeans::getCannotLinksPenalty(const int idx1, const int cltId1) {
 	return totalVar + totalMLPen + totalCLPen;
 }
 
-float PCKMeans::totalVariance() {
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::totalVariance() {
 	float var = 0.0f;
 	for (int idx = 0; idx < nData; ++idx) {
 		int cltId = vAssign.at(idx);
@@ -149,21 +552,26 @@ float PCKMeans::totalVariance() {
 	return var;
 }
 
-float PCKMeans::totalMLPenalty() {
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::totalMLPenalty() {
+	if (CONSTRAINT_COMPONENTS == constraintModel) {
+		return totalMLPenaltyByComponents();
+	}
 	float penalty = 0.0f;
 	countMLViolation = 0;
 
-	for (const auto& it : constr->ML) {
-		int idx1 = it.first;
+	for (int idx1 = 0; idx1 < constr->ML.numPoints(); ++idx1) {
 		int cltId1 = vAssign[idx1];
+		ConstraintAdjacency::Range mustLinks = constr->ML.neighbors(idx1);
 
-		for (const int& idx2 : it.second) {
-			int cltId2 = vAssign[idx2];
+		for (int k = 0; k < mustLinks.size(); ++k) {
+			int cltId2 = vAssign[mustLinks.first[k]];
 			if (cltId1 != cltId2) {
 				countMLViolation++;
+				int linkIdx = mustLinks.offset + k;
 				penalty += 0.5 * (
-					distanceByCluster(idx1, idx2, cltId1) +
-					distanceByCluster(idx1, idx2, cltId2)
+					mlDistanceByCluster(linkIdx, cltId1) +
+					mlDistanceByCluster(linkIdx, cltId2)
 				);
 			}
 		}
@@ -173,22 +581,27 @@ float PCKMeans::totalMLPenalty() {
 	return penalty * 0.5;
 }
 
-float PCKMeans::totalCLPenalty() {
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::totalCLPenalty() {
+	if (CONSTRAINT_COMPONENTS == constraintModel) {
+		return totalCLPenaltyByComponents();
+	}
 	float penalty = 0.0f;
 	countCLViolation = 0;
 
-	for (const auto& it : constr->CL) {
-		int idx1 = it.first;
+	for (int idx1 = 0; idx1 < constr->CL.numPoints(); ++idx1) {
+		ConstraintAdjacency::Range cannotLinks = constr->CL.neighbors(idx1);
+		if (cannotLinks.empty()) continue;
 		int cltId1 = vAssign[idx1];
 		float maxDistanceByOneCluster = maxDistanceByCluster(cltId1);
 
-		for (const int& idx2 : it.second) {
-			int cltId2 = vAssign[idx2];
+		for (int k = 0; k < cannotLinks.size(); ++k) {
+			int cltId2 = vAssign[cannotLinks.first[k]];
 			if (cltId1 == cltId2) {
 				countCLViolation++;
 				penalty += (
 					maxDistanceByOneCluster -
-					distanceByCluster(idx1, idx2, cltId1)
+					clDistanceByCluster(cannotLinks.offset + k, cltId1)
 				);
 			}
 		}
@@ -200,8 +613,58 @@ float PCKMeans::totalCLPenalty() {
 	return penalty;
 }
 
-/*virtual*/ EMResult PCKMeans::getResult() {
-    EMResult result = EMKMeans::getResult();
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::totalMLPenaltyByComponents() {
+	// countMLViolation counts the ordered pairs, as totalMLPenalty
+	const ConstraintComponents& components = constr->components;
+	float penalty = 0.0f;
+	countMLViolation = 0;
+	std::vector<GroupPart> parts;
+	for (int comp = 0; comp < components.numComponents(); ++comp) {
+		for (const int& idx : components.members(comp)) {
+			int cltId1 = vAssign[idx];
+			int nParts = collectGroupParts(comp, idx, parts, 0);
+			for (int p = 0; p < nParts; ++p) {
+				const GroupPart& part = parts[p];
+				if (part.cltId == cltId1) continue;
+				countMLViolation += part.count;
+				penalty += 0.5 * part.count * (
+					vMetric[cltId1]->distanceToCenter(data.col(idx), part.center) +
+					vMetric[part.cltId]->distanceToCenter(data.col(idx), part.center)
+				);
+			}
+		}
+	}
+	return penalty * 0.5;
+}
+
+template <typename Storage, typename Acc>
+float PCKMeans<Storage, Acc>::totalCLPenaltyByComponents() {
+	const ConstraintComponents& components = constr->components;
+	float penalty = 0.0f;
+	countCLViolation = 0;
+	for (int comp = 0; comp < components.numComponents(); ++comp) {
+		for (const int& comp2 : components.cannotLinked(comp)) {
+			for (const int& idx : components.members(comp)) {
+				int cltId1 = vAssign[idx];
+				const GroupSum* group = findGroupSum(comp2, cltId1);
+				if (nullptr == group) continue;
+				int count = group->count;
+				countCLViolation += count;
+				VectorXf center = group->sum / (float) count;
+				penalty += count * (
+					maxDistanceByCluster(cltId1) -
+					vMetric[cltId1]->distanceToCenter(data.col(idx), center)
+				);
+			}
+		}
+	}
+	return penalty;
+}
+
+template <typename Storage, typename Acc>
+/*virtual*/ EMResult PCKMeans<Storage, Acc>::getResult() {
+    EMResult result = Base::getResult();
 
     result.nConstraintOriginal = constr->nConstraintsOriginal;
 	result.nConstraintDeduced = constr->nConstraintsDeduced;
@@ -215,4 +678,8 @@ float PCKMeans::totalCLPenalty() {
     return result;
 }
 
+template class PCKMeans<float, float>;
+template class PCKMeans<float, double>;
+template class PCKMeans<Eigen::half, float>;
+
 } /* namespace dml */
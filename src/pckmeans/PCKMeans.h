@@ -13,47 +13,184 @@
 #include "../constraint/ConstraintsManager.h"
 
 #include <string>
+#include <vector>
 
 namespace dml {
 
-class PCKMeans : public EMKMeans {
+template <typename Storage = float, typename Acc = float>
+class PCKMeans : public EMKMeans<Storage, Acc> {
 public:
-	PCKMeans(const ConstMatrixRef& dataset, const int numClts, 
+	typedef EMKMeans<Storage, Acc> Base;
+	typedef typename Base::GaussianType GaussianType;
+	typedef typename Base::ConstDataRef ConstDataRef;
+
+	PCKMeans(const ConstDataRef& dataset, const int numClts,
 		const std::string constraintFileName, const CovType type = COV_NONE);
-		
+	PCKMeans(const ConstDataRef& dataset, const int numClts,
+		const ConstraintPtr constraints, const CovType type = COV_NONE);
+
 	virtual ~PCKMeans();
 
 	virtual void createInitCenters();
 	virtual void doVeryFirstClustering();
 	virtual void findBestCluster(const std::vector<int>& randomIndex);
 
+	int bestCluster(const int idx);
 	float getVariance(const int idx, const int cltId);
 	float getMustLinksPenalty(const int idx1, const int cltId1);
 	float getCannotLinksPenalty(const int idx1, const int cltId1);
 
+	virtual void setDiameterMethod(const DiameterMethod method);
+	virtual void setConstraintModel(const ConstraintModel model);
+	virtual void setMetricRank(const int rank);
+	virtual void setLogger(const LogFunc& log);
 	virtual void updateMixtures();
 	virtual float calculateObjFunc();
 	virtual EMResult getResult();
 	
 protected:
+	using Base::nData;
+	using Base::nDims;
+	using Base::nClusters;
+	using Base::data;
+	using Base::vAssign;
+	using Base::vMixture;
+	using Base::nThreads;
+	using Base::onlineUpdate;
+	using Base::currIter;
+	using Base::constraintModel;
+	using Base::miniBatchSize;
+	using Base::vObjFuncCached;
+	using Base::rng;
+	using Base::logger;
+
+	// sequential E-step in which each move updates the two means, and the
+	// diagonal statistics of local metrics, at once; the distances to a moved
+	// mean or under a moved metric are evaluated on demand until the M-step
+	void findBestClusterOnline(const std::vector<int>& randomIndex);
+
+	// E-step on nThreads: the points without constraint in one parallel-for,
+	// then the points of each color of the constraint graph concurrently
+	void findBestClusterByColor();
+
 	float totalVariance();
 	float totalMLPenalty();
 	float totalCLPenalty();
 
-	// using the same codebase for global metric and local metric
-	virtual float distanceByCluster(int idx1, int idx2, int cltId = -1);
-	virtual float distanceToMeanOfCluster(int idx, int cltId = -1);
-	virtual float maxDistanceByCluster(int cltId = -1);
-	virtual float logDetByCluster(int cltId = -1);
+	// vAssign[idx] = cltId, keeping the component statistics up to date
+	void reassign(const int idx, const int cltId);
+
+	/**
+	 * CONSTRAINT_COMPONENTS: the members of a component that lie in one
+	 * cluster are seen through their count and center, the distance of a point
+	 * to them is count * distance to their center. The distances are not
+	 * squared, so this is an approximation of the pairs model: a lower bound
+	 * of the sum of the distances (convexity), equal when the members
+	 * coincide. The M-step impacts (ComponentMoments.h) are exact.
+	 */
+	struct GroupSum {
+		int cltId;
+		int count;
+		Eigen::VectorXf sum;
+	};
+	struct GroupPart {
+		int cltId;
+		int count;
+		Eigen::VectorXf center;
+		float ownDist;		// distance to center under the metric of cltId
+	};
+	void buildComponentStats();
+	// the part of comp in cltId, nullptr when no member of comp is in cltId
+	GroupSum* findGroupSum(const int comp, const int cltId);
+	// the members of comp (without the point skipIdx) by cluster, written to
+	// parts from position nParts on; the slots are reused with their storage.
+	// Returns the new number of parts
+	int collectGroupParts(const int comp, const int skipIdx,
+		std::vector<GroupPart>& parts, int nParts);
+	int bestClusterByComponents(const int idx);
+	float totalMLPenaltyByComponents();
+	float totalCLPenaltyByComponents();
+
+	// fill distP2M, called once per iteration
+	virtual void cacheDistPoint2Mean();
+
+	/**
+	 * mini-batch: the distances to the means are evaluated on demand (no
+	 * distP2M), the metrics and the cached link distances change once per
+	 * epoch (about nData points seen)
+	 */
+	virtual void startMiniBatch();
+	virtual void sampleBatch(std::vector<int>& batch);
+	virtual float miniBatchStep(const std::vector<int>& batch);
+	virtual void finishMiniBatch();
+	void commitMiniBatchMetrics();
+
+	// the distinct gaussians of vMetric (one for a global metric)
+	std::vector<GaussianType*> metricGaussians();
+	virtual void saveMetrics(ClusteringState& state);
+	virtual void restoreMetrics(const ClusteringState& state);
+	virtual void resumeCaches();
+	// the cost of idx in cltId, the term of the objective function
+	float pointCost(const int idx, const int cltId);
+
+	// using the same codebase for global metric and local metric:
+	// the cached distances are plain lookups, resolved once per run by vMetric
+	// distance of the link at position linkIdx in the adjacency of ML / CL
+	float mlDistanceByCluster(int linkIdx, int cltId) {
+		return vMetric[cltId]->mlDistance(linkIdx);
+	}
+	float clDistanceByCluster(int linkIdx, int cltId) {
+		return vMetric[cltId]->clDistance(linkIdx);
+	}
+	// the same, evaluated on the link (idx1, idx2) when the online E-step
+	// moved the metric of cltId since the cache was filled
+	float mlDistanceByCluster(int linkIdx, int cltId, int idx1, int idx2) {
+		if (!vMetricMoved.empty() && vMetricMoved[cltId]) {
+			return vMetric[cltId]->applyDistance(data.col(idx1), data.col(idx2));
+		}
+		return vMetric[cltId]->mlDistance(linkIdx);
+	}
+	float clDistanceByCluster(int linkIdx, int cltId, int idx1, int idx2) {
+		if (!vMetricMoved.empty() && vMetricMoved[cltId]) {
+			return vMetric[cltId]->applyDistance(data.col(idx1), data.col(idx2));
+		}
+		return vMetric[cltId]->clDistance(linkIdx);
+	}
+	float distanceToMeanOfCluster(int idx, int cltId) {
+		if (!vMeanMoved.empty() && vMeanMoved[cltId]) {
+			return vMetric[cltId]->distanceToCenter(data.col(idx), movedMeans.col(cltId));
+		}
+		return distP2M(idx, cltId);
+	}
+	float maxDistanceByCluster(int cltId) {
+		return vMetric[cltId]->getMaxDistance(data);
+	}
+	float logDetByCluster(int cltId) {
+		return vMetric[cltId]->getLogDet();
+	}
 
 protected:
 	ConstraintPtr constr;
+	std::vector<GaussianType*> vMetric;	// gaussian whose metric is used by each cluster
+	Eigen::MatrixXf distP2M;		// distP2M(idx, cltId): distance of point idx to mean of cltId
+	std::vector<int> vUnconstrained;	// points without any ML or CL
+	std::vector<char> vMeanMoved;	// mean changed since distP2M was filled (online E-step)
+	Eigen::MatrixXf movedMeans;		// current mean of the moved clusters
+	std::vector<char> vMetricMoved;	// metric changed since the link distances were cached
+	// compParts[comp]: count and sum of the members of comp in each cluster
+	// they occupy, sorted by cluster (linear in the constrained points)
+	std::vector<std::vector<GroupSum> > compParts;
+	int nBatchesSinceCommit = 0;	// mini-batch: batches since the metrics changed
 	
 public:
 	int countMLViolation = 0;
 	int countCLViolation = 0;
 };
 
+extern template class PCKMeans<float, float>;
+extern template class PCKMeans<float, double>;
+extern template class PCKMeans<Eigen::half, float>;
+
 } /* namespace dml */
 
 #endif /* PCKMEANS_PCKMEANS_H_ */	
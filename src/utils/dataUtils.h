@@ -15,6 +15,8 @@
 #include <stdexcept>
 #include "Eigen3.h"
 #include "functionUtils.h"
+#include "matrixFile.h"
+#include "textLoader.h"
 
 using namespace Eigen;
 
@@ -22,48 +24,88 @@ using namespace Eigen;
  * read ground truth file into a vector: grouthTruth[imageId] = classId
  * the number of ground truth classes is assigned to in-out param nClasses
  */
-std::vector<int> readGroundTruth(const std::string fileName, int& nClasses) {
+inline std::vector<int> readGroundTruth(const std::string fileName, int& nClasses,
+    dml::LoadStats* stats = nullptr, const int nThreads = 0) {
     std::ifstream infile(fileName.c_str());
     if (!infile.is_open()) {
         throw std::runtime_error("Unable to open grouth truth file: " + fileName);
     }
+    infile.close();
 
     // read number of grouth truth class
-    infile >> nClasses;
+    dml::TextLoader loader(fileName, nThreads);
+    nClasses = loader.readHeaderToken<int>();
 
     // build grouth truth label: grouthTruth[imageId] = classId
-    std::vector<int> grouthTruth;
-    int idx = 0, classId = 0;
-    while (infile >> idx >> classId) {
-        grouthTruth.push_back(classId);
-    }
-    infile.close();
+    // the body is a list of pairs (imageId, classId), classId is the odd token
+    size_t nTokens = loader.countBodyTokens();
+    std::vector<int> grouthTruth(nTokens / 2);
+    loader.parseBody<int>([&](size_t tokenIdx, int value) {
+        if (1 == tokenIdx % 2 && tokenIdx / 2 < grouthTruth.size()) {
+            grouthTruth[tokenIdx / 2] = value;
+        }
+    });
+    if (nullptr != stats) *stats = loader.getStats();
     return grouthTruth;
 }
 
-inline MatrixXf readMatrix(const std::string fileName) {
-    MatrixXf mat;
+/**
+ * read text .mat file: "dimensions D examples N" followed by D rows of N values,
+ * the values are written straight into the column-major buffer of the matrix,
+ * Scalar is the storage type (float, double, Eigen::half)
+ */
+template <typename Scalar = float>
+inline MatrixX<Scalar> readMatrix(const std::string fileName,
+    dml::LoadStats* stats = nullptr, const int nThreads = 0) {
+    MatrixX<Scalar> mat;
     std::ifstream infile(fileName.c_str());
     if (!infile.is_open()) {
         std::cerr << "Can not open mat file: " << fileName << std::endl;
         return mat;
     }
-    std::string keyName;
-	int nExamples = 0;
-	int nDimensions = 0;
-	float val = 0.0f;
-	infile >> keyName >> nDimensions >> keyName >> nExamples;
-	mat = MatrixXf(nDimensions, nExamples);
-
-	for (int dim = 0; dim < nDimensions; ++dim) {
-		for (int exampleIdx = 0; exampleIdx < nExamples; ++exampleIdx) {
-			infile >> val;
-			mat(dim, exampleIdx) = val;
-		}
-	}
+    infile.close();
+
+    dml::TextLoader loader(fileName, nThreads);
+    loader.skipHeaderToken();
+    int nDimensions = loader.readHeaderToken<int>();
+    loader.skipHeaderToken();
+    int nExamples = loader.readHeaderToken<int>();
+
+    size_t nValues = (size_t) nDimensions * nExamples;
+    if (loader.countBodyTokens() < nValues) {
+        throw std::runtime_error("Missing values in mat file: " + fileName);
+    }
+
+    mat = MatrixX<Scalar>(nDimensions, nExamples);
+    Scalar* buffer = mat.data();
+    loader.parseBody<float>([=](size_t tokenIdx, float val) {
+        if (tokenIdx < nValues) {
+            size_t dim = tokenIdx / nExamples;
+            size_t exampleIdx = tokenIdx % nExamples;
+            buffer[exampleIdx * nDimensions + dim] = Scalar(val);
+        }
+    });
+    if (nullptr != stats) *stats = loader.getStats();
     return mat;
 }
 
+/**
+ * load a dataset matrix, the format is detected from the first bytes of the file:
+ * binary dataset (see matrixFile.h) and float32 .npy are mmap-ed without copy,
+ * anything else is parsed as text .mat file
+ */
+inline dml::DataMatrix loadDataMatrix(const std::string fileName,
+	dml::LoadStats* stats = nullptr) {
+	switch (dml::detectMatrixFileFormat(fileName)) {
+		case dml::FORMAT_BINARY:
+			return dml::DataMatrix::fromBinaryFile(fileName);
+		case dml::FORMAT_NPY:
+			return dml::DataMatrix::fromNpyFile(fileName);
+		default:
+			return dml::DataMatrix(readMatrix(fileName, stats));
+	}
+}
+
 /*
  * Distribution of value in Wang with rgSIFT, codebook size = 200
  * minValue: 0, maxValue: 11.4308
@@ -109,10 +151,8 @@ inline void writeWangDBtoMatFile(int nData = 1000, int nDims = 200) {
 
 	char fileName[128];
 	sprintf(fileName, "WangDatabase/wang-%d-%d.mat", nData, nDims);
-	std::ofstream ofs(fileName, std::ios::binary);
-	ofs.write((char*) data.data(), data.size() * sizeof(float));
-	ofs.close();
-	delete rawData;
+	dml::writeMatrixFile(fileName, data);
+	delete[] rawData;
 }
 
 /**
@@ -121,48 +161,17 @@ inline void writeWangDBtoMatFile(int nData = 1000, int nDims = 200) {
 inline MatrixXf readWangDBFromMatFile(int nData = 1000, int nDims = 200) {
 	char fileName[128];
 	sprintf(fileName, "WangDatabase/wang-%d-%d.mat", nData, nDims);
-	std::ifstream infile(fileName, std::ios::binary);
-	if (!infile.is_open()) {
-		std::cerr << "Can not open data file: " << fileName;
-		exit(-1);
-	}
-	MatrixXf data(nDims, nData);
-	infile.read((char *) data.data(), nDims * nData * sizeof(float));
-	infile.close();
-	return data;
+	dml::DataMatrix data = dml::DataMatrix::fromBinaryFile(fileName);
+	assert(data.matrix().rows() == nDims && data.matrix().cols() == nData);
+	return data.matrix();
 }
 
 inline MatrixXf getPCA(const Ref<const MatrixXf>& X, int k = 2) {
-	// do compare EVD SVD
-
-	//std::cout << "\n\nEVD:\n\n";
+	// the covariance is symmetric: eigenvalues in increasing order, the
+	// principal components are the last columns
 	MatrixXf cov = X*X.transpose() * (1.0 / (X.cols() - 1));
-	EigenSolver<MatrixXf> ev(cov);
-	// float sumEigenValues = ev.eigenvalues().real().sum();
-	// float acc0 = 0.0f;
-	// for (int i = 0; i < ev.eigenvalues().real().size(); ++i) {
-	// 	acc0 += ev.eigenvalues().real()[i];
-	// 	std::cout << "Principale component " << i
-	// 		<< "\twith value: " << ev.eigenvalues().real()[i]
-	// 		<< "\taccumulate: " << acc0
-	// 		<< "\texplains " << (acc0 /sumEigenValues)*100 << " % data\n";
-	// }
-
-	//std::cout << "\n\nSVD:\n\n";
-	JacobiSVD<MatrixXf> svd(X, ComputeThinU);
-	// float sumSingularVars = svd.singularValues().array().square().sum() / (X.cols() - 1);
-	// float acc = 0.0f;
-	// for (int i = 0; i < svd.singularValues().size(); ++i) {
-	// 	float sv = (svd.singularValues()[i]) * (svd.singularValues()[i]) / (X.cols() - 1);
-	// 	acc += sv;
-	// 	std::cout << "Principale component " << i
-	// 		<< "\twith value: " << sv
-	// 		<< "\taccumulate: " << acc
-	// 		<< "\texplains " << (acc /sumSingularVars)*100 << " % data\n";
-	// }
-
-	return ev.eigenvectors().real().leftCols(k).transpose() * X;
-	// return svd.matrixU().leftCols(k).transpose() * X;
+	SelfAdjointEigenSolver<MatrixXf> ev(cov);
+	return ev.eigenvectors().rightCols(k).rowwise().reverse().transpose() * X;
 }
 
 inline void writePCAResult(const Ref<const MatrixXf>& Xp, const std::vector<int>& vAssign) {
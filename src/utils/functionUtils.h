@@ -68,6 +68,14 @@ inline void shuffleVector(std::vector<int>& v) {
 
 }
 
+/**
+ * the same with the engine of the caller instead of std::rand, reproducible
+ * from the state of the engine
+ */
+inline void shuffleVector(std::vector<int>& v, std::mt19937& engine) {
+	std::shuffle(std::begin(v), std::end(v), engine);
+}
+
 /**
  * @return string format of input int, eg (int) 10 => (string) 010
  * example: http://stackoverflow.com/questions/2815746/formatting-an-integer-in-c
@@ -98,6 +106,10 @@ inline int randomInRange(const int minRange = 0, const int maxRange = 100) {
 	return minRange + std::rand() % maxRange;
 }
 
+inline int randomInRange(const int minRange, const int maxRange, std::mt19937& engine) {
+	return minRange + std::uniform_int_distribution<int>(0, maxRange - 1)(engine);
+}
+
 /**
  * VMeasure: http://www1.cs.columbia.edu/~amaxwell/pubs/v_measure-emnlp07.pdf
  * @param vAssigment the assigment of each data point to its cluster
@@ -0,0 +1,429 @@
+/*
+ * matrixFile.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Binary dataset format (versioned header + raw payload) and .npy reader.
+ * Both are mmap-ed and exposed through an Eigen::Map, so loading a float32
+ * dataset does not copy nor parse anything.
+ *
+ * Layout of a binary dataset file:
+ *   [MatrixFileHeader, padded to MATRIX_FILE_HEADER_SIZE bytes][payload]
+ * The payload stores nDims x nExamples values, one column is one example.
+ */
+
+#ifndef UTILS_MATRIXFILE_H_
+#define UTILS_MATRIXFILE_H_
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Eigen3.h"
+
+namespace dml {
+
+const static char MATRIX_FILE_MAGIC[8] = {'D', 'M', 'L', 'M', 'A', 'T', '\0', '\0'};
+const static char NPY_MAGIC[6] = {'\x93', 'N', 'U', 'M', 'P', 'Y'};
+const static uint32_t MATRIX_FILE_VERSION = 1;
+const static size_t MATRIX_FILE_HEADER_SIZE = 64;
+
+enum MatrixDType : uint32_t {
+	DTYPE_FLOAT32 = 0, DTYPE_FLOAT64 = 1
+};
+
+enum MatrixLayout : uint32_t {
+	LAYOUT_COL_MAJOR = 0,	// one example is contiguous (native Eigen layout)
+	LAYOUT_ROW_MAJOR = 1	// one dimension is contiguous
+};
+
+enum MatrixFileFormat {
+	FORMAT_TEXT, FORMAT_BINARY, FORMAT_NPY
+};
+
+struct MatrixFileHeader {
+	char magic[8];
+	uint32_t version = MATRIX_FILE_VERSION;
+	uint32_t dtype = DTYPE_FLOAT32;
+	uint32_t layout = LAYOUT_COL_MAJOR;
+	uint32_t reserved = 0;
+	uint64_t nDims = 0;
+	uint64_t nExamples = 0;
+	uint64_t checksum = 0;		// FNV-1a of the payload
+};
+
+static_assert(sizeof(MatrixFileHeader) <= MATRIX_FILE_HEADER_SIZE, "Header too big");
+
+/**
+ * bytes of a (nDims x nExamples) payload, refused when the size overflows
+ */
+inline size_t payloadBytes(const uint64_t nDims, const uint64_t nExamples, const size_t scalarSize,
+	const std::string& fileName) {
+	uint64_t maxValues = std::numeric_limits<size_t>::max() / scalarSize;
+	if (nDims > 0 && nExamples > maxValues / nDims) {
+		throw std::runtime_error("Dataset too large: " + fileName);
+	}
+	return nDims * nExamples * scalarSize;
+}
+
+/**
+ * 64-bit FNV-1a, consuming the buffer by 8-byte words (tail byte by byte)
+ */
+inline uint64_t checksumFNV1a(const void* buffer, size_t nBytes) {
+	const uint64_t prime = 1099511628211ULL;
+	uint64_t hash = 14695981039346656037ULL;
+	const unsigned char* bytes = static_cast<const unsigned char*>(buffer);
+
+	size_t nWords = nBytes / sizeof(uint64_t);
+	for (size_t i = 0; i < nWords; ++i) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+		hash = (hash ^ word) * prime;
+	}
+	for (size_t i = nWords * sizeof(uint64_t); i < nBytes; ++i) {
+		hash = (hash ^ bytes[i]) * prime;
+	}
+	return hash;
+}
+
+/**
+ * Read-only memory mapping of a whole file, unmapped on destruction
+ */
+class MappedFile {
+public:
+	MappedFile() {}
+	explicit MappedFile(const std::string& fileName) { open(fileName); }
+	~MappedFile() { close(); }
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	MappedFile(MappedFile&& other) { *this = std::move(other); }
+	MappedFile& operator=(MappedFile&& other) {
+		if (this != &other) {
+			close();
+			std::swap(addr, other.addr);
+			std::swap(nBytes, other.nBytes);
+		}
+		return *this;
+	}
+
+	void open(const std::string& fileName) {
+		close();
+		int fd = ::open(fileName.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Can not open file: " + fileName);
+		}
+		struct stat st;
+		if (0 != fstat(fd, &st)) {
+			::close(fd);
+			throw std::runtime_error("Can not stat file: " + fileName);
+		}
+		nBytes = (size_t) st.st_size;
+		if (nBytes > 0) {
+			addr = mmap(nullptr, nBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (MAP_FAILED == addr) {
+				addr = nullptr;
+				::close(fd);
+				throw std::runtime_error("Can not mmap file: " + fileName);
+			}
+			madvise(addr, nBytes, MADV_SEQUENTIAL);
+		}
+		::close(fd);
+	}
+
+	void close() {
+		if (nullptr != addr) {
+			munmap(addr, nBytes);
+		}
+		addr = nullptr;
+		nBytes = 0;
+	}
+
+	const char* data() const { return static_cast<const char*>(addr); }
+	size_t size() const { return nBytes; }
+
+private:
+	void* addr = nullptr;
+	size_t nBytes = 0;
+};
+
+/**
+ * Detect the format of a dataset file from its first bytes
+ */
+inline MatrixFileFormat detectMatrixFileFormat(const std::string& fileName) {
+	std::ifstream infile(fileName.c_str(), std::ios::binary);
+	if (!infile.is_open()) {
+		throw std::runtime_error("Can not open mat file: " + fileName);
+	}
+	char magic[8] = {0};
+	infile.read(magic, sizeof(magic));
+	if (infile.gcount() >= 8 && 0 == std::memcmp(magic, MATRIX_FILE_MAGIC, 8)) {
+		return FORMAT_BINARY;
+	}
+	if (infile.gcount() >= 6 && 0 == std::memcmp(magic, NPY_MAGIC, 6)) {
+		return FORMAT_NPY;
+	}
+	return FORMAT_TEXT;
+}
+
+/**
+ * Write a matrix (one column is one example) into the binary dataset format
+ */
+inline void writeMatrixFile(const std::string& fileName,
+	const Eigen::Ref<const Eigen::MatrixXf>& X) {
+	std::ofstream ofs(fileName.c_str(), std::ios::binary);
+	if (!ofs.is_open()) {
+		throw std::runtime_error("Can not open file to write: " + fileName);
+	}
+
+	// Ref may have an outer stride, so make the payload contiguous first
+	Eigen::MatrixXf payload = X;
+	size_t nBytes = payload.size() * sizeof(float);
+
+	MatrixFileHeader header;
+	std::memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+	header.nDims = payload.rows();
+	header.nExamples = payload.cols();
+	header.checksum = checksumFNV1a(payload.data(), nBytes);
+
+	char headerBlock[MATRIX_FILE_HEADER_SIZE] = {0};
+	std::memcpy(headerBlock, &header, sizeof(header));
+	ofs.write(headerBlock, MATRIX_FILE_HEADER_SIZE);
+	ofs.write((const char*) payload.data(), nBytes);
+	if (!ofs.good()) {
+		throw std::runtime_error("Error while writing file: " + fileName);
+	}
+	ofs.close();
+}
+
+/**
+ * A dataset matrix which is either a zero-copy view on a mmap-ed file
+ * or an owned matrix (text file, or on-disk layout that needs a conversion).
+ * The view returned by matrix() is valid as long as this object lives.
+ */
+class DataMatrix {
+public:
+	typedef Eigen::Map<const Eigen::MatrixXf> MapType;
+
+	DataMatrix() {}
+	explicit DataMatrix(Eigen::MatrixXf&& mat) : owned(std::move(mat)) {
+		bind(owned.data(), owned.rows(), owned.cols());
+	}
+
+	DataMatrix(const DataMatrix&) = delete;
+	DataMatrix& operator=(const DataMatrix&) = delete;
+	DataMatrix(DataMatrix&& other) { *this = std::move(other); }
+	DataMatrix& operator=(DataMatrix&& other) {
+		if (this == &other) return *this;
+		// both the mapping and the heap buffer of owned keep their address on move
+		file = std::move(other.file);
+		owned = std::move(other.owned);
+		bind(other.ptr, other.nRows, other.nCols);
+		other.bind(nullptr, 0, 0);
+		return *this;
+	}
+
+	MapType matrix() const { return MapType(ptr, nRows, nCols); }
+	bool isMapped() const { return file.size() > 0 && 0 == owned.size(); }
+
+	static DataMatrix fromBinaryFile(const std::string& fileName, bool verifyChecksum = true);
+	static DataMatrix fromNpyFile(const std::string& fileName);
+
+private:
+	void bind(const float* p, Eigen::Index rows, Eigen::Index cols) {
+		ptr = p;
+		nRows = rows;
+		nCols = cols;
+	}
+
+	MappedFile file;
+	Eigen::MatrixXf owned;
+	const float* ptr = nullptr;
+	Eigen::Index nRows = 0;
+	Eigen::Index nCols = 0;
+};
+
+inline DataMatrix DataMatrix::fromBinaryFile(const std::string& fileName, bool verifyChecksum) {
+	DataMatrix result;
+	result.file.open(fileName);
+	const char* base = result.file.data();
+
+	if (result.file.size() < MATRIX_FILE_HEADER_SIZE) {
+		throw std::runtime_error("Truncated binary dataset: " + fileName);
+	}
+	MatrixFileHeader header;
+	std::memcpy(&header, base, sizeof(header));
+	if (0 != std::memcmp(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic))) {
+		throw std::runtime_error("Not a binary dataset: " + fileName);
+	}
+	if (header.version > MATRIX_FILE_VERSION) {
+		throw std::runtime_error("Unsupported binary dataset version: " + fileName);
+	}
+	if (DTYPE_FLOAT32 != header.dtype && DTYPE_FLOAT64 != header.dtype) {
+		throw std::runtime_error("Unsupported binary dataset dtype "
+			+ std::to_string(header.dtype) + ": " + fileName);
+	}
+	if (LAYOUT_COL_MAJOR != header.layout && LAYOUT_ROW_MAJOR != header.layout) {
+		throw std::runtime_error("Unsupported binary dataset layout "
+			+ std::to_string(header.layout) + ": " + fileName);
+	}
+
+	size_t scalarSize = (DTYPE_FLOAT64 == header.dtype) ? sizeof(double) : sizeof(float);
+	size_t nBytes = payloadBytes(header.nDims, header.nExamples, scalarSize, fileName);
+	if (result.file.size() < MATRIX_FILE_HEADER_SIZE + nBytes) {
+		throw std::runtime_error("Truncated binary dataset: " + fileName);
+	}
+
+	const char* payload = base + MATRIX_FILE_HEADER_SIZE;
+	if (verifyChecksum && header.checksum != checksumFNV1a(payload, nBytes)) {
+		throw std::runtime_error("Checksum mismatch in binary dataset: " + fileName);
+	}
+
+	Eigen::Index nDims = header.nDims;
+	Eigen::Index nExamples = header.nExamples;
+	if (DTYPE_FLOAT32 == header.dtype && LAYOUT_COL_MAJOR == header.layout) {
+		// the only zero-copy case
+		result.bind(reinterpret_cast<const float*>(payload), nDims, nExamples);
+		return result;
+	}
+
+	if (DTYPE_FLOAT32 == header.dtype) {
+		typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMat;
+		result.owned = Eigen::Map<const RowMajorMat>(
+			reinterpret_cast<const float*>(payload), nDims, nExamples);
+	} else if (LAYOUT_COL_MAJOR == header.layout) {
+		result.owned = Eigen::Map<const Eigen::MatrixXd>(
+			reinterpret_cast<const double*>(payload), nDims, nExamples).cast<float>();
+	} else {
+		typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMat;
+		result.owned = Eigen::Map<const RowMajorMat>(
+			reinterpret_cast<const double*>(payload), nDims, nExamples).cast<float>();
+	}
+	result.file.close();
+	result.bind(result.owned.data(), nDims, nExamples);
+	return result;
+}
+
+/**
+ * .npy file of shape (nExamples, nDims): a C-ordered float32 array is exactly
+ * the column-major (nDims x nExamples) matrix, so it is mapped without copy.
+ * Other layouts / float64 are converted.
+ * Format spec: https://numpy.org/doc/stable/reference/generated/numpy.lib.format.html
+ */
+inline DataMatrix DataMatrix::fromNpyFile(const std::string& fileName) {
+	DataMatrix result;
+	result.file.open(fileName);
+	const char* base = result.file.data();
+	size_t fileSize = result.file.size();
+
+	if (fileSize < 10 || 0 != std::memcmp(base, NPY_MAGIC, sizeof(NPY_MAGIC))) {
+		throw std::runtime_error("Not a npy file: " + fileName);
+	}
+	unsigned char major = base[6];
+	size_t headerLen = 0, prefixLen = 0;
+	if (1 == major) {
+		headerLen = (unsigned char) base[8] | ((unsigned char) base[9] << 8);
+		prefixLen = 10;
+	} else {
+		if (fileSize < 12) throw std::runtime_error("Truncated npy file: " + fileName);
+		uint32_t len32 = 0;
+		std::memcpy(&len32, base + 8, sizeof(len32));
+		headerLen = len32;
+		prefixLen = 12;
+	}
+	if (fileSize < prefixLen + headerLen) {
+		throw std::runtime_error("Truncated npy file: " + fileName);
+	}
+	std::string dict(base + prefixLen, headerLen);
+
+	auto valueOf = [&](const std::string& key) -> std::string {
+		size_t pos = dict.find("'" + key + "'");
+		if (std::string::npos == pos) {
+			throw std::runtime_error("Missing key " + key + " in npy header: " + fileName);
+		}
+		pos = dict.find(':', pos);
+		size_t start = (std::string::npos == pos) ? pos : dict.find_first_not_of(" ", pos + 1);
+		if (std::string::npos == start) {
+			throw std::runtime_error("Malformed npy header: " + fileName);
+		}
+		size_t end = ('(' == dict[start]) ? dict.find(')', start) : dict.find_first_of(",}", start);
+		if (std::string::npos == end) {
+			throw std::runtime_error("Malformed npy header: " + fileName);
+		}
+		if ('(' == dict[start]) ++end;
+		return dict.substr(start, end - start);
+	};
+
+	std::string descr = valueOf("descr");
+	bool isFloat32 = (std::string::npos != descr.find("<f4"));
+	bool isFloat64 = (std::string::npos != descr.find("<f8"));
+	if (!isFloat32 && !isFloat64) {
+		throw std::runtime_error("Unsupported npy dtype " + descr + ": " + fileName);
+	}
+	bool fortranOrder = (std::string::npos != valueOf("fortran_order").find("True"));
+
+	// shape is "(nExamples, nDims)", any other number of dimensions is refused
+	std::string shape = valueOf("shape");
+	std::vector<long long> extents;
+	const char* pos = shape.c_str() + 1;
+	while (true) {
+		char* end = nullptr;
+		long long extent = std::strtoll(pos, &end, 10);
+		if (end == pos) break;
+		extents.push_back(extent);
+		pos = end + std::strspn(end, " ");
+		if (',' != *pos) break;
+		++pos;
+	}
+	bool validShape = ('(' == shape[0]) && (')' == *(pos + std::strspn(pos, " ")))
+		&& (2 == extents.size()) && (extents[0] >= 0) && (extents[1] >= 0);
+	if (!validShape) {
+		throw std::runtime_error("Unsupported npy shape " + shape
+			+ " (expected (nExamples, nDims)): " + fileName);
+	}
+	Eigen::Index nExamples = extents[0], nDims = extents[1];
+
+	size_t scalarSize = isFloat32 ? sizeof(float) : sizeof(double);
+	const char* payload = base + prefixLen + headerLen;
+	size_t nBytes = payloadBytes(nDims, nExamples, scalarSize, fileName);
+	if (fileSize - prefixLen - headerLen < nBytes) {
+		throw std::runtime_error("Truncated npy file: " + fileName);
+	}
+
+	if (isFloat32 && (!fortranOrder || 1 == nDims)) {
+		result.bind(reinterpret_cast<const float*>(payload), nDims, nExamples);
+		return result;
+	}
+
+	// fortran order: memory is the column-major (nExamples x nDims) matrix
+	if (isFloat32) {
+		result.owned = Eigen::Map<const Eigen::MatrixXf>(
+			reinterpret_cast<const float*>(payload), nExamples, nDims).transpose();
+	} else if (fortranOrder) {
+		result.owned = Eigen::Map<const Eigen::MatrixXd>(
+			reinterpret_cast<const double*>(payload), nExamples, nDims).transpose().cast<float>();
+	} else {
+		result.owned = Eigen::Map<const Eigen::MatrixXd>(
+			reinterpret_cast<const double*>(payload), nDims, nExamples).cast<float>();
+	}
+	result.file.close();
+	result.bind(result.owned.data(), nDims, nExamples);
+	return result;
+}
+
+} /* namespace dml */
+
+#endif /* UTILS_MATRIXFILE_H_ */
@@ -0,0 +1,215 @@
+/*
+ * parallelUtils.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Small helpers to run independent tasks on std::thread
+ */
+
+#ifndef UTILS_PARALLELUTILS_H_
+#define UTILS_PARALLELUTILS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Eigen3.h"
+
+namespace dml {
+
+/**
+ * number of threads to use when the caller does not specify it (0 or negative)
+ */
+inline int resolveNumThreads(const int nThreads = 0) {
+	if (nThreads > 0) return nThreads;
+	unsigned int nCores = std::thread::hardware_concurrency();
+	return (nCores > 0) ? (int) nCores : 1;
+}
+
+/**
+ * set once at startup, before any run: Eigen's own threads (only when built
+ * with OpenMP) are capped to 1 when runs, or the clusters inside a run,
+ * execute concurrently, so that the tasks do not each spawn their own threads
+ * for products and decompositions; left to Eigen otherwise
+ */
+inline void configureEigenThreads(const int nConcurrentRuns, const int nThreadsPerRun) {
+	if (resolveNumThreads(nConcurrentRuns) > 1 || resolveNumThreads(nThreadsPerRun) > 1) {
+		Eigen::setNbThreads(1);
+	}
+}
+
+/**
+ * call func(taskId) for taskId in [0, nTasks) using at most nThreads threads.
+ * Tasks are handed out dynamically, the calling thread takes part in the work.
+ * The first exception thrown by a task is rethrown after all threads joined.
+ */
+template <typename Func>
+void parallelFor(const int nTasks, const int nThreads, Func func) {
+	int nWorkers = std::min(resolveNumThreads(nThreads), nTasks);
+	if (nWorkers <= 1) {
+		for (int taskId = 0; taskId < nTasks; ++taskId) {
+			func(taskId);
+		}
+		return;
+	}
+
+	std::atomic<int> nextTask(0);
+	std::exception_ptr firstError = nullptr;
+	std::atomic_flag errorLock = ATOMIC_FLAG_INIT;
+
+	auto worker = [&]() {
+		int taskId = 0;
+		while ((taskId = nextTask.fetch_add(1)) < nTasks) {
+			try {
+				func(taskId);
+			} catch (...) {
+				if (!errorLock.test_and_set()) {
+					firstError = std::current_exception();
+				}
+				nextTask = nTasks;	// stop handing out tasks
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(nWorkers - 1);
+	for (int i = 0; i < nWorkers - 1; ++i) {
+		threads.emplace_back(worker);
+	}
+	worker();
+	for (auto& t : threads) {
+		t.join();
+	}
+	if (firstError) {
+		std::rethrow_exception(firstError);
+	}
+}
+
+/**
+ * Run a batch of independent jobs on a fixed number of workers.
+ * Jobs are sorted by decreasing estimated cost (longest first) and dealt
+ * round-robin to one deque per worker. A worker pops the front of its own
+ * deque and, once it is empty, steals from the back of the others, so the
+ * long jobs start early and the short ones fill the idle workers at the end.
+ */
+class WorkStealingScheduler {
+public:
+	typedef std::function<void()> JobFunc;
+
+	explicit WorkStealingScheduler(const int numWorkers = 0)
+		: nWorkers(resolveNumThreads(numWorkers)) {}
+
+	/**
+	 * add a job, cost is only used to order the jobs (any unit)
+	 */
+	void submit(const float cost, JobFunc job) {
+		pending.push_back(std::make_pair(cost, std::move(job)));
+	}
+
+	/**
+	 * run all submitted jobs and block until they are done. The first exception
+	 * thrown by a job is rethrown, the jobs that were not started are dropped.
+	 */
+	void runAll() {
+		std::stable_sort(pending.begin(), pending.end(),
+			[](const CostJob& a, const CostJob& b) { return a.first > b.first; });
+
+		int nThreads = std::max(1, std::min(nWorkers, (int) pending.size()));
+		queues.clear();
+		for (int w = 0; w < nThreads; ++w) {
+			queues.emplace_back(new WorkerQueue());
+		}
+		for (size_t i = 0; i < pending.size(); ++i) {
+			queues[i % nThreads]->jobs.push_back(std::move(pending[i].second));
+		}
+		pending.clear();
+
+		nStolen = 0;
+		stop = false;
+		firstError = nullptr;
+
+		std::vector<std::thread> threads;
+		for (int w = 1; w < nThreads; ++w) {
+			threads.emplace_back(&WorkStealingScheduler::work, this, w);
+		}
+		work(0);
+		for (auto& t : threads) {
+			t.join();
+		}
+		queues.clear();
+		if (firstError) {
+			std::rethrow_exception(firstError);
+		}
+	}
+
+	int getNumWorkers() const { return nWorkers; }
+	int getNumStolen() const { return nStolen; }
+
+private:
+	typedef std::pair<float, JobFunc> CostJob;
+
+	struct WorkerQueue {
+		std::mutex lock;
+		std::deque<JobFunc> jobs;
+	};
+
+	bool popOwn(const int workerId, JobFunc& job) {
+		WorkerQueue& q = *queues[workerId];
+		std::lock_guard<std::mutex> guard(q.lock);
+		if (q.jobs.empty()) return false;
+		job = std::move(q.jobs.front());
+		q.jobs.pop_front();
+		return true;
+	}
+
+	bool steal(const int thiefId, JobFunc& job) {
+		int nQueues = (int) queues.size();
+		for (int i = 1; i < nQueues; ++i) {
+			WorkerQueue& q = *queues[(thiefId + i) % nQueues];
+			std::lock_guard<std::mutex> guard(q.lock);
+			if (!q.jobs.empty()) {
+				job = std::move(q.jobs.back());
+				q.jobs.pop_back();
+				++nStolen;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void work(const int workerId) {
+		JobFunc job;
+		// jobs are never added while running, so empty queues mean the end
+		while (!stop && (popOwn(workerId, job) || steal(workerId, job))) {
+			try {
+				job();
+			} catch (...) {
+				std::lock_guard<std::mutex> guard(errorLock);
+				if (!firstError) {
+					firstError = std::current_exception();
+				}
+				stop = true;
+			}
+		}
+	}
+
+	int nWorkers = 1;
+	std::vector<CostJob> pending;
+	std::vector<std::unique_ptr<WorkerQueue> > queues;
+	std::atomic<int> nStolen{0};
+	std::atomic<bool> stop{false};
+	std::mutex errorLock;
+	std::exception_ptr firstError = nullptr;
+};
+
+} /* namespace dml */
+
+#endif /* UTILS_PARALLELUTILS_H_ */
@@ -0,0 +1,206 @@
+/*
+ * requestServer.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Line framed request / response loop, over stdin / stdout or a Unix domain
+ * socket. A request is the lines up to a line "end", a response ends with a
+ * line "end" too. The request "shutdown" stops the server.
+ * A request over MAX_REQUEST_LINES lines or MAX_REQUEST_BYTES bytes is
+ * read up to its "end" line without being kept, and answered by an error.
+ * The connections of the socket are served one after another.
+ */
+
+#ifndef UTILS_REQUESTSERVER_H_
+#define UTILS_REQUESTSERVER_H_
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace dml {
+
+const static std::string REQUEST_END = "end";
+const static std::string REQUEST_SHUTDOWN = "shutdown";
+const static size_t MAX_REQUEST_LINES = 1 << 20;
+const static size_t MAX_REQUEST_BYTES = 64 << 20;
+
+/**
+ * lines: the request without its "end" line, the response is written into out
+ * (without its "end" line)
+ */
+typedef std::function<void(const std::vector<std::string>& lines, std::ostream& out)> RequestHandler;
+
+/**
+ * stream buffer on a connected socket; writes do not raise SIGPIPE when the
+ * client went away, the stream just fails
+ */
+class SocketStreamBuf : public std::streambuf {
+public:
+	explicit SocketStreamBuf(const int socketFd) : fd(socketFd) {
+		setg(inBuffer, inBuffer, inBuffer);
+		setp(outBuffer, outBuffer + sizeof(outBuffer));
+	}
+	virtual ~SocketStreamBuf() { sync(); }
+
+protected:
+	virtual int_type underflow() {
+		ssize_t nRead = ::recv(fd, inBuffer, sizeof(inBuffer), 0);
+		if (nRead <= 0) return traits_type::eof();
+		setg(inBuffer, inBuffer, inBuffer + nRead);
+		return traits_type::to_int_type(inBuffer[0]);
+	}
+
+	virtual int_type overflow(int_type ch) {
+		if (0 != sync()) return traits_type::eof();
+		if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+			*pptr() = traits_type::to_char_type(ch);
+			pbump(1);
+		}
+		return traits_type::not_eof(ch);
+	}
+
+	virtual int sync() {
+		const char* data = pbase();
+		while (data < pptr()) {
+			ssize_t nSent = ::send(fd, data, pptr() - data, MSG_NOSIGNAL);
+			if (nSent <= 0) return -1;
+			data += nSent;
+		}
+		setp(outBuffer, outBuffer + sizeof(outBuffer));
+		return 0;
+	}
+
+private:
+	int fd;
+	char inBuffer[1 << 16];
+	char outBuffer[1 << 16];
+};
+
+/**
+ * std::getline which keeps at most maxBytes characters of the line, the rest
+ * is read and dropped. False at the end of the stream, as std::getline
+ */
+inline bool getBoundedLine(std::istream& in, std::string& line, const size_t maxBytes,
+	bool& truncated) {
+	line.clear();
+	truncated = false;
+	std::streambuf* buffer = in.rdbuf();
+	bool readAny = false;
+	while (true) {
+		std::streambuf::int_type ch = buffer->sbumpc();
+		if (std::streambuf::traits_type::eq_int_type(ch, std::streambuf::traits_type::eof())) {
+			in.setstate(std::ios::eofbit);
+			return readAny;
+		}
+		readAny = true;
+		char c = std::streambuf::traits_type::to_char_type(ch);
+		if ('\n' == c) return true;
+		if (line.size() < maxBytes) {
+			line.push_back(c);
+		} else {
+			truncated = true;
+		}
+	}
+}
+
+/**
+ * serve the requests of one stream until it ends, false if a shutdown was requested
+ */
+inline bool serveStream(std::istream& in, std::ostream& out, const RequestHandler& handler) {
+	std::vector<std::string> lines;
+	std::string line;
+	size_t nBytes = 0;
+	bool tooLarge = false, truncated = false;
+	while (getBoundedLine(in, line, MAX_REQUEST_BYTES, truncated)) {
+		if (!line.empty() && '\r' == line.back()) line.pop_back();
+		if (REQUEST_SHUTDOWN == line && lines.empty() && !tooLarge) {
+			out << REQUEST_END << std::endl;
+			return false;
+		}
+		if (REQUEST_END != line) {
+			// past the limits the lines are dropped until the end of the request
+			nBytes += line.size() + 1;
+			tooLarge = tooLarge || truncated || nBytes > MAX_REQUEST_BYTES
+				|| lines.size() >= MAX_REQUEST_LINES;
+			if (tooLarge) {
+				lines.clear();
+			} else {
+				lines.push_back(line);
+			}
+			continue;
+		}
+		if (tooLarge) {
+			out << "error Request over " << MAX_REQUEST_LINES << " lines or "
+				<< MAX_REQUEST_BYTES << " bytes\n";
+		} else {
+			handler(lines, out);
+		}
+		out << REQUEST_END << std::endl;
+		lines.clear();
+		nBytes = 0;
+		tooLarge = false;
+		if (!out.good()) break;
+	}
+	return true;
+}
+
+/**
+ * listen on the Unix domain socket socketPath (replaced if it exists) and
+ * serve its connections until a shutdown is requested
+ */
+inline void serveUnixSocket(const std::string& socketPath, const RequestHandler& handler) {
+	sockaddr_un address;
+	std::memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socketPath.size() >= sizeof(address.sun_path)) {
+		throw std::runtime_error("Socket path too long: " + socketPath);
+	}
+	std::strncpy(address.sun_path, socketPath.c_str(), sizeof(address.sun_path) - 1);
+
+	int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0) {
+		throw std::runtime_error("Can not create socket: " + socketPath);
+	}
+	::unlink(socketPath.c_str());
+	if (0 != ::bind(listenFd, (const sockaddr*) &address, sizeof(address))
+		|| 0 != ::listen(listenFd, 8)) {
+		::close(listenFd);
+		throw std::runtime_error("Can not listen on socket: " + socketPath);
+	}
+
+	bool running = true;
+	while (running) {
+		int clientFd = ::accept(listenFd, nullptr, nullptr);
+		if (clientFd < 0) {
+			// a signal or a client gone before accept, any other error persists
+			if (EINTR == errno || ECONNABORTED == errno) continue;
+			std::cerr << "Can not accept on socket " << socketPath << ": "
+				<< std::strerror(errno) << std::endl;
+			break;
+		}
+		{
+			SocketStreamBuf buffer(clientFd);
+			std::istream in(&buffer);
+			std::ostream out(&buffer);
+			running = serveStream(in, out, handler);
+		}
+		::close(clientFd);
+	}
+	::close(listenFd);
+	::unlink(socketPath.c_str());
+}
+
+} /* namespace dml */
+
+#endif /* UTILS_REQUESTSERVER_H_ */
@@ -0,0 +1,429 @@
+/*
+ * selfTests.cpp
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ */
+
+#include "selfTests.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "../gaussian/SimpleGaussian.cpp"
+#include "../gaussian/DiagGaussian.cpp"
+#include "../gaussian/FullGaussian.cpp"
+#include "../gaussian/LowRankGaussian.cpp"
+#include "../gaussian/SymmetricDecomposition.h"
+#include "../gaussian/ComponentMoments.h"
+#include "../constraint/ConstraintComponents.h"
+#include "../constraint/ConstraintsManager.h"
+#include "../globalMetric/GlobalMetricKMeans.h"
+#include "../api/dmlApi.h"
+
+using namespace Eigen;
+
+/**
+ * nanoseconds per distance between the pairs (idx1[k], idx2[k]) of X
+ */
+template <typename DistFunc>
+double timeDistances(const Ref<const MatrixXf>& X, const std::vector<int>& idx1,
+	const std::vector<int>& idx2, DistFunc dist, float& checksum) {
+	auto t1 = std::chrono::high_resolution_clock::now();
+	float sum = 0.0f;
+	for (size_t k = 0; k < idx1.size(); ++k) {
+		sum += dist(X.col(idx1[k]), X.col(idx2[k]));
+	}
+	auto t2 = std::chrono::high_resolution_clock::now();
+	checksum = sum;
+	return std::chrono::duration<double, std::nano>(t2 - t1).count() / idx1.size();
+}
+
+/**
+ * per distance cost of the runtime dispatch (virtual Gaussian::applyDistance
+ * with Eigen::Ref arguments) against the inlined metric policy
+ */
+template <typename Metric>
+void benchmarkMetric(const std::string name, const Ref<const MatrixXf>& X, const Metric& metric,
+	const std::vector<int>& idx1, const std::vector<int>& idx2) {
+	typedef typename Metric::template GaussianType<float, float> MetricGaussian;
+	std::shared_ptr<dml::Gaussian<> > gaussian(
+		new MetricGaussian(dml::GLOBAL_GAUSSIAN_ID, X.cols(), X.rows()));
+	static_cast<MetricGaussian*>(gaussian.get())->setMetric(metric);
+
+	float sumVirtual = 0.0f, sumPolicy = 0.0f;
+	double nsVirtual = timeDistances(X, idx1, idx2,
+		[&](const dml::Gaussian<>::ConstPointRef& v1, const dml::Gaussian<>::ConstPointRef& v2) {
+			return gaussian->applyDistance(v1, v2);
+		}, sumVirtual);
+	double nsPolicy = timeDistances(X, idx1, idx2,
+		[&](const auto& v1, const auto& v2) {
+			return metric.distance(v1, v2);
+		}, sumPolicy);
+
+	std::cout << name << ":\tvirtual = " << nsVirtual << " ns\tpolicy = " << nsPolicy
+		<< " ns\tspeedup = " << nsVirtual / nsPolicy
+		<< "\t(checksum " << sumVirtual << " / " << sumPolicy << ")\n";
+}
+
+void benchmarkDistanceDispatch(const Ref<const MatrixXf>& X, const int nPairs) {
+	std::vector<int> idx1(nPairs), idx2(nPairs);
+	for (int k = 0; k < nPairs; ++k) {
+		idx1[k] = std::rand() % X.cols();
+		idx2[k] = std::rand() % X.cols();
+	}
+	std::cout << "Distance benchmark: " << nPairs << " pairs, dimensions = " << X.rows() << '\n';
+
+	MatrixXf X_aligned = X.colwise() - X.rowwise().mean();
+	MatrixXf covMat = (1.0f / X.cols()) * X_aligned * X_aligned.transpose();
+	JacobiSVD<MatrixXf> svd(covMat, ComputeThinU);
+	VectorXf covDiag = covMat.diagonal().array() + 0.001f;
+
+	dml::DiagonalMetric diag(X.rows());
+	diag.setCovDiag(covDiag);
+	dml::FullMetric full(X.rows());
+	full.setDecomposition(svd.singularValues().array() + 0.001f, svd.matrixU().transpose());
+	dml::SymmetricDecomposition<float> decomposition(covMat + 0.001f * MatrixXf::Identity(X.rows(), X.rows()));
+	dml::FullMetric cholesky(X.rows());
+	cholesky.setDecomposition(decomposition.getCovDiag(), decomposition.getTrans());
+	int rank = std::max(1, std::min<int>(dml::DEFAULT_METRIC_RANK, X.rows() - 1));
+	VectorXf spectrum(rank + 1);
+	spectrum.head(rank) = svd.singularValues().head(rank).array() + 0.001f;
+	spectrum[rank] = svd.singularValues().tail(X.rows() - rank).mean() + 0.001f;
+	dml::LowRankMetric lowRank(X.rows());
+	lowRank.setDecomposition(spectrum, svd.matrixU().leftCols(rank).transpose());
+
+	benchmarkMetric("euclidean", X, dml::EuclideanMetric(X.rows()), idx1, idx2);
+	benchmarkMetric("diagonal", X, diag, idx1, idx2);
+	benchmarkMetric("full", X, full, idx1, idx2);
+	benchmarkMetric(decomposition.isCholesky() ? "full (cholesky)" : "full (eigen)", X, cholesky, idx1, idx2);
+	benchmarkMetric("lowrank", X, lowRank, idx1, idx2);
+}
+
+/**
+ * milliseconds of one decomposition of a d x d covariance: the Jacobi SVD of
+ * the former path, the symmetric eigensolver, and SymmetricDecomposition on a
+ * positive definite (Cholesky) and on an indefinite (eigensolver + jitter) matrix
+ */
+void benchmarkCovDecomposition(const int maxDims) {
+	auto timeMs = [](const std::function<void()>& run) {
+		auto t1 = std::chrono::high_resolution_clock::now();
+		run();
+		auto t2 = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration<double, std::milli>(t2 - t1).count();
+	};
+	std::cout << "Covariance decomposition benchmark (ms)\n"
+		<< "d\tJacobiSVD\tSelfAdjoint\tCholesky\tIndefinite\tjitter\tlogDet SVD / Cholesky\n";
+	for (int nDims = 25; nDims <= maxDims; nDims *= 2) {
+		MatrixXf X = MatrixXf::Random(nDims, 4 * nDims);
+		MatrixXf X_aligned = X.colwise() - X.rowwise().mean();
+		MatrixXf covMat = (1.0f / X.cols()) * X_aligned * X_aligned.transpose();
+		// a cannot-link like impact: minus a few outer products
+		MatrixXf indefinite = covMat - 2.0f * X_aligned.leftCols(3) * X_aligned.leftCols(3).transpose();
+
+		float logDetSVD = 0.0f, logDetChol = 0.0f, jitter = 0.0f;
+		double msSVD = timeMs([&]() {
+			JacobiSVD<MatrixXf> svd(covMat, ComputeThinU);
+			logDetSVD = svd.singularValues().array().log().sum();
+		});
+		double msEigen = timeMs([&]() {
+			SelfAdjointEigenSolver<MatrixXf> solver(covMat);
+		});
+		double msChol = timeMs([&]() {
+			dml::SymmetricDecomposition<float> decomposition(covMat);
+			logDetChol = decomposition.logDet();
+		});
+		double msIndefinite = timeMs([&]() {
+			dml::SymmetricDecomposition<float> decomposition(indefinite);
+			jitter = decomposition.getJitter();
+		});
+		std::cout << nDims << '\t' << msSVD << '\t' << msEigen << '\t' << msChol
+			<< '\t' << msIndefinite << '\t' << jitter
+			<< '\t' << logDetSVD << " / " << logDetChol << '\n';
+	}
+}
+
+/**
+ * the component formulas of ComponentMoments.h against the explicit pairwise
+ * sums, on random components split over random clusters. The data is offset
+ * far from the origin, where uncentered moments in float would cancel.
+ * Returns the largest relative error of the full / diagonal impacts.
+ */
+template <typename Acc>
+Acc testComponentMoments(const int nDims, const int nClusters, const float offset) {
+	typedef Matrix<Acc, Dynamic, Dynamic> AccMatrix;
+	typedef Matrix<Acc, Dynamic, 1> AccVector;
+	const int nGroups = 12, groupSize = 5;
+	int nData = nGroups * groupSize;
+	MatrixXf X = MatrixXf::Random(nDims, nData).array() + offset;
+	std::vector<int> vAssign(nData);
+	std::vector<std::vector<int> > groups(nGroups);
+	for (int idx = 0; idx < nData; ++idx) {
+		vAssign[idx] = std::rand() % nClusters;
+		groups[idx % nGroups].push_back(idx);
+	}
+	std::vector<std::pair<int, int> > groupLinks;
+	for (int g = 0; g + 1 < nGroups; ++g) {
+		groupLinks.push_back(std::make_pair(g, g + 1));
+		if (g + 3 < nGroups) groupLinks.push_back(std::make_pair(g, g + 3));
+	}
+	dml::ConstraintComponents components;
+	components.build(groups, groupLinks, nData);
+
+	dml::ComponentParts<Acc, AccMatrix> fullParts;
+	dml::ComponentParts<Acc, AccVector> diagParts;
+	dml::componentMoments(X, vAssign, components, fullParts);
+	dml::componentMoments(X, vAssign, components, diagParts);
+
+	auto outer = [&](const int i, const int j) {
+		AccVector diff = (X.col(i) - X.col(j)).template cast<Acc>();
+		return AccMatrix(diff * diff.transpose());
+	};
+	auto relError = [](const AccMatrix& value, const AccMatrix& expected) {
+		return (value - expected).norm() / std::max(expected.norm(), Acc(1e-12));
+	};
+
+	Acc maxError = 0;
+	for (int cltId = -1; cltId < nClusters; ++cltId) {	// -1: every cluster
+		bool allClusters = (cltId < 0);
+		AccMatrix mlExpected = AccMatrix::Zero(nDims, nDims), clExpected = mlExpected;
+		AccMatrix mlFull = mlExpected, clFull = mlExpected;
+		AccVector mlDiag = AccVector::Zero(nDims), clDiag = mlDiag;
+		int nML = 0, nCL = 0, nExpectedML = 0, nExpectedCL = 0, nDiag = 0;
+		for (int comp = 0; comp < components.numComponents(); ++comp) {
+			for (const int& i : components.members(comp)) {
+				if (!allClusters && vAssign[i] != cltId) continue;
+				for (const int& j : components.members(comp)) {
+					if (vAssign[j] == vAssign[i]) continue;
+					mlExpected += outer(i, j);
+					nExpectedML++;
+				}
+			}
+			dml::addMustLinkScatter(fullParts[comp], cltId, allClusters, mlFull, nML);
+			dml::addMustLinkScatter(diagParts[comp], cltId, allClusters, mlDiag, nDiag);
+			for (const int& comp2 : components.cannotLinked(comp)) {
+				if (comp2 < comp) continue;
+				for (const int& i : components.members(comp)) {
+					if (!allClusters && vAssign[i] != cltId) continue;
+					for (const int& j : components.members(comp2)) {
+						if (vAssign[j] != vAssign[i]) continue;
+						clExpected -= Acc(2) * outer(i, j);
+						nExpectedCL += 2;
+					}
+				}
+				dml::subtractCannotLinkScatter(fullParts[comp], fullParts[comp2], cltId, allClusters, clFull, nCL);
+				dml::subtractCannotLinkScatter(diagParts[comp], diagParts[comp2], cltId, allClusters, clDiag, nDiag);
+			}
+		}
+		if (nML != nExpectedML || nCL != nExpectedCL) return std::numeric_limits<Acc>::max();
+		maxError = std::max({maxError, relError(mlFull, mlExpected), relError(clFull, clExpected),
+			relError(mlDiag, mlExpected.diagonal()), relError(clDiag, clExpected.diagonal())});
+	}
+	return maxError;
+}
+
+template float testComponentMoments<float>(const int, const int, const float);
+template double testComponentMoments<double>(const int, const int, const float);
+
+/**
+ * the online E-step of the local diagonal metrics (DiagGaussian::movePoint)
+ * against gaussians rebuilt from vAssign after each move: random points move
+ * between random clusters of a set with random ML / CL links. Returns the
+ * largest relative error of the covDiag and of the logDet.
+ */
+template <typename Acc>
+Acc testOnlineStatistics(const int nData, const int nDims, const int nClusters,
+	const int nMoves) {
+	typedef dml::DiagGaussian<float, Acc> LocalGaussian;
+	MatrixXf X = MatrixXf::Random(nDims, nData);
+	std::vector<int> vAssign(nData);
+	for (int idx = 0; idx < nData; ++idx) {
+		vAssign[idx] = idx % nClusters;
+	}
+	std::vector<std::pair<int, int> > mlLinks, clLinks;
+	for (int i = 0; i < 2 * nData; ++i) {
+		int idx1 = std::rand() % nData, idx2 = std::rand() % nData;
+		if (idx1 == idx2) continue;
+		auto& links = (0 == i % 2) ? mlLinks : clLinks;
+		links.push_back(std::make_pair(idx1, idx2));
+		links.push_back(std::make_pair(idx2, idx1));
+	}
+	std::shared_ptr<dml::ConstraintsManager> constraints(new dml::ConstraintsManager(""));
+	constraints->refineConstraints(mlLinks, clLinks);
+	constraints->deriveConnectedComponents();
+
+	// the gaussians of an M-step on vAssign
+	auto mStep = [&]() {
+		std::vector<std::unique_ptr<LocalGaussian> > gaussians;
+		for (int cltId = 0; cltId < nClusters; ++cltId) {
+			gaussians.emplace_back(new LocalGaussian(cltId, nData, nDims));
+			gaussians.back()->resetStatistics();
+		}
+		for (int idx = 0; idx < nData; ++idx) {
+			gaussians[vAssign[idx]]->addPoint(X, idx);
+		}
+		for (auto& gaussian : gaussians) {
+			gaussian->updateMean();
+			gaussian->updateConstraintImpact(X, vAssign, constraints);
+		}
+		return gaussians;
+	};
+
+	auto online = mStep();
+	Acc maxError = 0;
+	for (int move = 0; move < nMoves; ++move) {
+		int idx = std::rand() % nData, oldClt = vAssign[idx], newClt = std::rand() % nClusters;
+		if (newClt == oldClt || online[oldClt]->getSize() <= 1) continue;
+		vAssign[idx] = newClt;
+		online[oldClt]->removeFromMean(X.col(idx));
+		online[newClt]->addToMean(X.col(idx));
+		online[oldClt]->movePoint(X, idx, oldClt, vAssign, constraints);
+		online[newClt]->movePoint(X, idx, oldClt, vAssign, constraints);
+
+		auto rebuilt = mStep();
+		for (int cltId = 0; cltId < nClusters; ++cltId) {
+			VectorXf covOnline, covRebuilt;
+			MatrixXf rotation;
+			online[cltId]->getMetricParameters(covOnline, rotation);
+			rebuilt[cltId]->getMetricParameters(covRebuilt, rotation);
+			float logDetOnline = online[cltId]->getLogDet(), logDetRebuilt = rebuilt[cltId]->getLogDet();
+			maxError = std::max({maxError, Acc((covOnline - covRebuilt).norm() / covRebuilt.norm()),
+				Acc(std::abs(logDetOnline - logDetRebuilt) / std::max(std::abs(logDetRebuilt), 1.0f))});
+		}
+	}
+	return maxError;
+}
+
+template double testOnlineStatistics<double>(const int, const int, const int, const int);
+
+/**
+ * the bound pruning and the k-d tree over the means only skip distances: the
+ * assignments of GlobalMetricKMeans with them on and off are the same
+ */
+template <typename Metric>
+bool samePrunedAssignments(const Ref<const MatrixXf>& X, const dml::ConstraintPtr constraints,
+	const int nClusters, const unsigned int seed) {
+	std::vector<int> exhaustive;
+	for (int mode = 0; mode < 4; ++mode) {
+		dml::GlobalMetricKMeans<Metric> algo(X, nClusters, constraints);
+		algo.setSeed(seed);
+		algo.setNumThreads(1);
+		algo.setBoundPruning(0 != (mode & 1));
+		algo.setCenterIndex(0 != (mode & 2));
+		std::vector<int> assignments = algo.doClustering(20, 0.01f);
+		if (0 == mode) {
+			exhaustive = assignments;
+		} else if (assignments != exhaustive) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * samePrunedAssignments for each metric, on gaussian blobs with must-links
+ * inside and cannot-links across the blobs. Returns the number of metrics
+ * whose assignments differ.
+ */
+int testPrunedAssignments(const int nData, const int nDims, const int nClusters) {
+	MatrixXf centers = 1.5f * MatrixXf::Random(nDims, nClusters);
+	MatrixXf X(nDims, nData);
+	std::vector<int> blob(nData);
+	for (int idx = 0; idx < nData; ++idx) {
+		blob[idx] = idx % nClusters;
+		X.col(idx) = centers.col(blob[idx]) + MatrixXf::Random(nDims, 1).cwiseProduct(
+			VectorXf::LinSpaced(nDims, 0.5f, 2.0f));
+	}
+	X = X.colwise() - X.rowwise().mean();
+
+	std::vector<std::pair<int, int> > mlLinks, clLinks;
+	while (mlLinks.size() < 100 || clLinks.size() < 100) {
+		int idx1 = std::rand() % nData, idx2 = std::rand() % nData;
+		if (idx1 == idx2) continue;
+		auto& links = (blob[idx1] == blob[idx2]) ? mlLinks : clLinks;
+		if (links.size() < 100) {
+			links.push_back(std::make_pair(idx1, idx2));
+			links.push_back(std::make_pair(idx2, idx1));
+		}
+	}
+	std::shared_ptr<dml::ConstraintsManager> constraints(new dml::ConstraintsManager(""));
+	constraints->refineConstraints(mlLinks, clLinks);
+	constraints->deriveConnectedComponents();
+
+	int nDiffer = 0;
+	auto report = [&](const std::string name, const bool same) {
+		std::cout << name << ":\t" << (same ? "same" : "DIFFERENT") << '\n';
+		nDiffer += same ? 0 : 1;
+	};
+	report("euclidean", samePrunedAssignments<dml::EuclideanMetric>(X, constraints, nClusters, 7));
+	report("diagonal", samePrunedAssignments<dml::DiagonalMetric>(X, constraints, nClusters, 7));
+	report("full", samePrunedAssignments<dml::FullMetric>(X, constraints, nClusters, 7));
+	report("lowrank", samePrunedAssignments<dml::LowRankMetric>(X, constraints, nClusters, 7));
+	return nDiffer;
+}
+
+/**
+ * dmlCluster on a small in-memory set: every DmlAlgorithm (the precisions in
+ * turn) fills the assignment, an out-of-range link and an invalid option are
+ * refused. Returns the number of failed checks.
+ */
+int testClusterApi(const int nData, const int nDims, const int nClusters) {
+	MatrixXf X = MatrixXf::Random(nDims, nData);
+	for (int idx = 0; idx < nData; ++idx) {
+		X(idx % nDims, idx) += 4.0f * (idx % nClusters);
+	}
+	X = X.colwise() - X.rowwise().mean();
+	std::vector<int> mustLinks, cannotLinks;
+	for (int idx = 0; idx + nClusters < nData; idx += 10) {
+		mustLinks.insert(mustLinks.end(), {idx, idx + nClusters});
+		cannotLinks.insert(cannotLinks.end(), {idx, idx + 1});
+	}
+	int numML = (int) mustLinks.size() / 2, numCL = (int) cannotLinks.size() / 2;
+
+	int nFailed = 0;
+	auto check = [&](const std::string name, const bool passed) {
+		if (!passed) {
+			std::cout << name << ":	FAILED " << dmlLastError() << '\n';
+			nFailed++;
+		}
+	};
+	DmlOptions options;
+	dmlDefaultOptions(&options);
+	options.numClusters = nClusters;
+	options.seed = 7;
+	std::vector<int> assignment(nData);
+	for (int algo = DML_PCKMEANS_NOMETRIC; algo <= DML_MPCKMEANS_LOCAL_LOWRANK; ++algo) {
+		options.algorithm = algo;
+		options.precision = algo % 3;
+		DmlResult result;
+		std::fill(assignment.begin(), assignment.end(), -1);
+		int status = dmlCluster(X.data(), nDims, nData, mustLinks.data(), numML,
+			cannotLinks.data(), numCL, &options, assignment.data(), &result);
+		bool filled = std::all_of(assignment.begin(), assignment.end(),
+			[&](const int cltId) { return cltId >= 0 && cltId < nClusters; });
+		check("algorithm " + std::to_string(algo), DML_OK == status && filled && result.iterations > 0);
+	}
+
+	// the errors leave the assignment as it is
+	options.algorithm = DML_PCKMEANS_NOMETRIC;
+	options.precision = DML_PRECISION_FLOAT;
+	std::fill(assignment.begin(), assignment.end(), -1);
+	std::vector<int> badLinks = {0, nData};
+	int status = dmlCluster(X.data(), nDims, nData, badLinks.data(), 1,
+		nullptr, 0, &options, assignment.data(), nullptr);
+	check("out-of-range link", DML_INVALID_ARGUMENT == status && 0 != dmlLastError()[0]
+		&& -1 == assignment[0]);
+	options.maxIteration = 0;
+	status = dmlCluster(X.data(), nDims, nData, nullptr, 0, nullptr, 0, &options, assignment.data(), nullptr);
+	check("maxIteration 0", DML_INVALID_ARGUMENT == status && -1 == assignment[0]);
+	return nFailed;
+}
@@ -0,0 +1,51 @@
+/*
+ * selfTests.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Benchmarks and self-tests run by the ml --bench-* / --test-* options,
+ * compiled in selfTests.cpp
+ */
+
+#ifndef UTILS_SELFTESTS_H_
+#define UTILS_SELFTESTS_H_
+
+#include "Eigen3.h"
+
+/**
+ * per distance cost of the virtual Gaussian::applyDistance against the metric policies
+ */
+void benchmarkDistanceDispatch(const Eigen::Ref<const Eigen::MatrixXf>& X, const int nPairs = 1000000);
+
+/**
+ * milliseconds of the covariance decompositions across the dimension
+ */
+void benchmarkCovDecomposition(const int maxDims = 400);
+
+/**
+ * largest relative error of the ML / CL component formulas against the pairwise sums
+ * (instantiated for float and double)
+ */
+template <typename Acc>
+Acc testComponentMoments(const int nDims = 6, const int nClusters = 4, const float offset = 1000.0f);
+
+/**
+ * largest relative error of the online diagonal metrics against a recomputation
+ * (instantiated for double)
+ */
+template <typename Acc>
+Acc testOnlineStatistics(const int nData = 300, const int nDims = 5, const int nClusters = 4,
+	const int nMoves = 200);
+
+/**
+ * number of metrics whose pruned assignments differ from the exhaustive E-step
+ */
+int testPrunedAssignments(const int nData = 2000, const int nDims = 10, const int nClusters = 8);
+
+/**
+ * number of failed checks of the C API
+ */
+int testClusterApi(const int nData = 200, const int nDims = 4, const int nClusters = 4);
+
+#endif /* UTILS_SELFTESTS_H_ */
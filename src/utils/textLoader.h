@@ -0,0 +1,189 @@
+/*
+ * textLoader.h
+ *
+ *  Created on: Oct 18, 2026
+ *      Author: vvminh
+ *
+ * Multi-threaded loader for whitespace separated text files (.mat, ground
+ * truth, .links). The mmap-ed file is split into byte ranges at whitespace
+ * boundaries, and it is parsed in two parallel passes:
+ *   1. count the tokens of each range -> global index of its first token
+ *   2. parse each range with std::from_chars, every token is handed to a sink
+ *      with its global index, so it is written straight to its destination
+ * Usage: read the header tokens, check countBodyTokens(), then parseBody().
+ */
+
+#ifndef UTILS_TEXTLOADER_H_
+#define UTILS_TEXTLOADER_H_
+
+#include <charconv>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "matrixFile.h"
+#include "parallelUtils.h"
+
+namespace dml {
+
+/**
+ * statistics of one load, to report the parse throughput
+ */
+struct LoadStats {
+	size_t nBytes = 0;
+	size_t nTokens = 0;
+	int nThreads = 0;
+	double milliseconds = 0.0;
+
+	double throughputMBs() const {
+		return (milliseconds > 0.0) ? (nBytes / (1024.0 * 1024.0)) / (milliseconds / 1000.0) : 0.0;
+	}
+};
+
+inline bool isSpaceChar(const char c) {
+	return ' ' == c || '\n' == c || '\t' == c || '\r' == c || '\v' == c || '\f' == c;
+}
+
+class TextLoader {
+public:
+	typedef std::pair<const char*, const char*> ByteRange;
+
+	// ranges smaller than this are not worth a thread
+	const static size_t MIN_CHUNK_BYTES = 1 << 20;
+
+	TextLoader(const std::string& fileName, const int numThreads = 0)
+		: file(fileName), name(fileName) {
+		nThreads = resolveNumThreads(numThreads);
+		cursor = file.data();
+		end = file.data() + file.size();
+	}
+
+	/**
+	 * read the next token serially (header fields at the start of the file)
+	 */
+	template <typename T>
+	T readHeaderToken() {
+		while (cursor < end && isSpaceChar(*cursor)) ++cursor;
+		T value{};
+		auto res = std::from_chars(cursor, end, value);
+		if (std::errc() != res.ec) {
+			throw std::runtime_error("Invalid header in file: " + name);
+		}
+		cursor = res.ptr;
+		return value;
+	}
+
+	/**
+	 * skip the next non numeric header token (eg. "dimensions")
+	 */
+	void skipHeaderToken() {
+		while (cursor < end && isSpaceChar(*cursor)) ++cursor;
+		while (cursor < end && !isSpaceChar(*cursor)) ++cursor;
+	}
+
+	/**
+	 * first pass: split the remaining bytes into ranges and count their tokens
+	 * @return number of tokens after the header
+	 */
+	size_t countBodyTokens() {
+		auto t1 = std::chrono::high_resolution_clock::now();
+
+		chunks = splitBody();
+		int nChunks = (int) chunks.size();
+		firstToken.assign(nChunks + 1, 0);
+		parallelFor(nChunks, nThreads, [&](int chunkId) {
+			firstToken[chunkId + 1] = countTokens(chunks[chunkId]);
+		});
+		for (int chunkId = 0; chunkId < nChunks; ++chunkId) {
+			firstToken[chunkId + 1] += firstToken[chunkId];
+		}
+
+		auto t2 = std::chrono::high_resolution_clock::now();
+		stats.nBytes = file.size();
+		stats.nTokens = firstToken[nChunks];
+		stats.nThreads = std::min(nThreads, std::max(nChunks, 1));
+		stats.milliseconds = std::chrono::duration<double, std::milli>(t2 - t1).count();
+		return stats.nTokens;
+	}
+
+	/**
+	 * second pass: parse all tokens after the header as T,
+	 * sink(tokenIndex, value) is called concurrently from several threads
+	 * with distinct token indices in [0, countBodyTokens())
+	 */
+	template <typename T, typename Sink>
+	void parseBody(Sink sink) {
+		if (firstToken.empty()) {
+			countBodyTokens();
+		}
+		auto t1 = std::chrono::high_resolution_clock::now();
+		parallelFor((int) chunks.size(), nThreads, [&](int chunkId) {
+			parseRange<T>(chunks[chunkId], firstToken[chunkId], sink);
+		});
+		auto t2 = std::chrono::high_resolution_clock::now();
+		stats.milliseconds += std::chrono::duration<double, std::milli>(t2 - t1).count();
+	}
+
+	const LoadStats& getStats() const { return stats; }
+
+private:
+	std::vector<ByteRange> splitBody() const {
+		std::vector<ByteRange> ranges;
+		size_t nBytes = end - cursor;
+		int nChunks = (int) std::min<size_t>(nThreads, nBytes / MIN_CHUNK_BYTES + 1);
+		size_t chunkSize = nBytes / nChunks + 1;
+
+		const char* begin = cursor;
+		while (begin < end) {
+			const char* stop = (size_t(end - begin) > chunkSize) ? begin + chunkSize : end;
+			// never cut a token in two
+			while (stop < end && !isSpaceChar(*stop)) ++stop;
+			ranges.push_back(std::make_pair(begin, stop));
+			begin = stop;
+		}
+		return ranges;
+	}
+
+	static size_t countTokens(const ByteRange& range) {
+		size_t nTokens = 0;
+		bool inToken = false;
+		for (const char* p = range.first; p < range.second; ++p) {
+			bool isSpace = isSpaceChar(*p);
+			nTokens += (!isSpace && !inToken);
+			inToken = !isSpace;
+		}
+		return nTokens;
+	}
+
+	template <typename T, typename Sink>
+	void parseRange(const ByteRange& range, size_t tokenIdx, Sink& sink) const {
+		const char* p = range.first;
+		while (true) {
+			while (p < range.second && isSpaceChar(*p)) ++p;
+			if (p >= range.second) break;
+			T value{};
+			auto res = std::from_chars(p, range.second, value);
+			bool endOfToken = (res.ptr == range.second) || isSpaceChar(*res.ptr);
+			if (std::errc() != res.ec || !endOfToken) {
+				throw std::runtime_error("Invalid token in file: " + name);
+			}
+			sink(tokenIdx++, value);
+			p = res.ptr;
+		}
+	}
+
+	MappedFile file;
+	std::string name;
+	int nThreads = 1;
+	const char* cursor = nullptr;
+	const char* end = nullptr;
+	std::vector<ByteRange> chunks;
+	std::vector<size_t> firstToken;
+	LoadStats stats;
+};
+
+} /* namespace dml */
+
+#endif /* UTILS_TEXTLOADER_H_ */